@@ -1,9 +1,26 @@
 // Display a cube, using glDrawElements
 
 #include "common.h"
+#include "uniforms.h"
+#include "occlusion.h"
+#include "chunk.h"
+#include "world_render.h"
+#include "fire_spread.h"
+#include "fluid_grid.h"
+#include "particle_emitter.h"
+#include "particle_budget.h"
+#include "startup_trace.h"
+#include "frame_stats.h"
+#include "hud.h"
+#include "telemetry.h"
+#include "frame_capture.h"
+#include "flight_recorder.h"
+#include "job_system.h"
 #include <chrono>
 #include <algorithm>
 #include <cmath>
+#include <iostream>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -11,14 +28,40 @@
 
 const char *WINDOW_TITLE = "Minecraft Fire";
 const double FRAME_RATE_MS = 1000.0/60.0;
-const int num_particles = 12;
+// Particles per second per emitter; the pools cap the total
+const float flame_rate = 18.0;
+const float smoke_rate = 2.0;
+const float ember_rate = 3.0;
+const int max_particles = 256;         // flame pool at budget scale 1; smoke and embers get half
+
+// The particle budget scales rates and caps within these limits to hold the target
+const double target_frame_ms = 1000.0 / 60.0;
+const float min_budget_scale = 0.1;
+const float max_budget_scale = 2.0;
+
+// The ground is a world_chunks x 1 x world_chunks block world centred on the campfire
+const int world_chunks = 2;
+const int ground_height = 4;
+const int num_trees = 10;
+const float block_size = 0.1;
+
+// Fire spread runs at a fixed tick rate; burning blocks become particle emitters
+const float fire_tick_seconds = 0.1;
+const int max_fire_ticks_per_frame = 4;
+const int max_fire_emitters = 20;
+
+// Heat/velocity grid over the campsite that carries the particles. Resolution and
+// pressure iterations are the cost knobs: a step is O(resolution^3 * iterations).
+const int fluid_resolution = 32;
+const int fluid_pressure_iterations = 20;
+const float fluid_source_heat = 60.0;    // heat per second injected at each emitter
+const float particle_own_velocity = 0.3; // share of a particle's launch velocity kept on top of the flow
 
 typedef glm::vec4  color4;
 typedef glm::vec4  point4;
 typedef glm::vec3  point3;
 typedef glm::vec2  point2;
 
-long long ms;
 float prev_time = 0.0;
 float curr_time;
 float time_delta;
@@ -29,9 +72,22 @@ float angle_sign = 1.0;
 enum { Xaxis = 0, Yaxis = 1, Zaxis = 2, NumAxes = 3 };
 int      Axis = Yaxis;
 GLfloat  Theta[NumAxes] = { 0.0, 0.0, 0.0 };
-GLuint  ModelView, Projection, SetColor, UseTexture;
+FrameUniforms frame_uniforms;
+Mesh cube_mesh;
+Mesh quad_mesh;
+int window_height = 512;
+const float near_plane = 0.5, far_plane = 5.0;
 
 color4 brown = color4(0.6, 0.3, 0.0, 1.0);
+const point3 campfire = point3(0.0, 0.2, 0.0);
+
+World world;
+Affine block_to_world;
+FireGrid fire;
+float fire_clock = 0.0;
+std::vector<glm::ivec3> tree_bases;
+FluidGrid fluid(glm::vec3(-1.6, 0.0, -1.6), glm::vec3(1.6, 1.6, 1.6));
+bool use_fluid = true;
 
 
 
@@ -65,6 +121,12 @@ point4 vertices[] = {
    point4(-0.5, -0.5, 0.5, 1.0),
    point4(0.5, -0.5, 0.5, 1.0),
    point4(0.5, -0.5, -0.5, 1.0),
+
+   // billboard quad in the xy plane
+   point4(-0.5, -0.5, 0.0, 1.0),
+   point4(-0.5, 0.5, 0.0, 1.0),
+   point4(0.5, 0.5, 0.0, 1.0),
+   point4(0.5, -0.5, 0.0, 1.0),
 };
 
 GLuint indices[] = {
@@ -74,6 +136,8 @@ GLuint indices[] = {
 	13, 12, 15, 13, 15, 14,
 	17, 16, 19, 17, 19, 18,
 	21, 20, 23, 21, 23, 22,
+
+	25, 24, 27, 25, 27, 26,
 };
 
 point2 uv_points[] = {
@@ -106,118 +170,261 @@ point2 uv_points[] = {
 	point2(0.0, 1.0),
 	point2(1.0, 1.0),
 	point2(1.0, 0.0),
+
+	point2(0.0, 0.0),
+	point2(0.0, 1.0),
+	point2(1.0, 1.0),
+	point2(1.0, 0.0),
 };
 
 
-glm::mat4 gen_rotate(GLfloat rot_x, GLfloat rot_y, GLfloat rot_z) {
-	glm::mat4 rotate;
-	rotate = glm::rotate(rotate, glm::radians(rot_x), glm::vec3(1, 0, 0));
-	rotate = glm::rotate(rotate, glm::radians(rot_y), glm::vec3(0, 1, 0));
-	rotate = glm::rotate(rotate, glm::radians(rot_z), glm::vec3(0, 0, 1));
-	return rotate;
+Affine gen_rotate(GLfloat rot_x, GLfloat rot_y, GLfloat rot_z) {
+	return affine_rotate(rot_x, rot_y, rot_z);
 }
 
-glm::mat4 gen_trans(float x, float y, float z) {
-	glm::mat4 trans;
-	return glm::translate(trans, glm::vec3(x, y, z));
+Affine gen_trans(float x, float y, float z) {
+	return affine_translate(x, y, z);
 }
 
-glm::mat4 gen_scale(float x, float y, float z) {
-	glm::mat4 scale;
-	return glm::scale(scale, glm::vec3(x, y, z));
+Affine gen_scale(float x, float y, float z) {
+	return affine_scale(x, y, z);
 }
 
-void draw_cube(glm::mat4 model_view, color4 color, int use_texture) {
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view));
-	glUniform4f(SetColor, color[0], color[1], color[2], color[3]);
-	glUniform1i(UseTexture, use_texture);
-	for (int i = 0; i < sizeof(indices) / sizeof(GLuint); i += 3) {
-		glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
-	}
+void draw_cube(const Affine &model, color4 color, int use_texture, const glm::vec4 &spin = glm::vec4(0.0)) {
+	submit_draw(cube_mesh, model, color, use_texture, false, spin);
 }
 
+// Particles whose cube would cover fewer pixels than this are drawn as camera-facing quads
+const float cube_lod_pixels = 8.0;
 
-class Particle {
-
-	float max_distance = float((rand() % 6) + 5) / 10.0;
-	float color_scale;
-	point2 initial_position_shift = point2(
-		float(2 * (rand() % 2) - 1)*float(rand() % 10)*0.005,
-		float(2 * (rand() % 2) - 1)*float(rand() % 10)*0.005
-	);
-	float speed = float((rand() % 100) + 50) * 0.01;
+struct ParticleLodStats {
+	int cubes;
+	int billboards;
+	int culled_transparent;
+	int culled_offscreen;
+	long triangles_saved;     // against drawing every live particle as a cube
+};
+ParticleLodStats particle_lod_stats;
 
-	glm::vec3 rot_axis = glm::vec3(rand() % 2, rand() % 2, rand() % 2);
-	float angular_speed = float(rand() % 5) + 5.0;
-	float angular_theta = 0.0;
-	glm::mat4 rot_matrix;
+// Flight recorder channels (see flight_recorder.h); ids in the recording when
+// replaying, else in flight_recorder. Particles are stored in draw order, i.e. in
+// pool order, which playback needs to blend them the same way (see flight_recorder.h).
+struct FlightChannels {
+	int theta, particle_position, particle_color, particle_spin, particle_size;
+};
+FlightChannels flight_channels;
+
+void init_flight_channels() {
+	FlightChannels &c = flight_channels;
+	if (flight_playback.active()) {
+		c.theta = flight_playback.channel("camera.theta");
+		c.particle_position = flight_playback.channel("particles.position");
+		c.particle_color = flight_playback.channel("particles.color");
+		c.particle_spin = flight_playback.channel("particles.spin");
+		c.particle_size = flight_playback.channel("particles.size");
+	} else {
+		c.theta = flight_recorder.add_channel("camera.theta", 0.01f);
+		c.particle_position = flight_recorder.add_channel("particles.position", 1e-4f);
+		c.particle_color = flight_recorder.add_channel("particles.color", 1.0f / 255.0f);
+		c.particle_spin = flight_recorder.add_channel("particles.spin", 1e-4f);
+		c.particle_size = flight_recorder.add_channel("particles.size", 1e-4f);
+	}
+}
 
-	float theta = glm::radians(float(rand() % 360));
-	float incline = glm::radians(float(rand() % 35));
-	point3 direction;
-	point3 position = point3(0.0, 0.2, 0.0);
-	color4 orange = color4(1.0, 0.6, 0.0, 1.0);
-	glm::mat4 scale = gen_scale(0.1, 0.1, 0.1);
+bool flight_particles_recorded() {
+	const FlightChannels &c = flight_channels;
+	return c.particle_position >= 0 && c.particle_color >= 0 && c.particle_spin >= 0 && c.particle_size >= 0;
+}
 
+// Flames, smoke and embers at the campfire and at every burning block
+class ParticleSystem {
 public:
-	void draw(glm::mat4 model_view) {
-		color_scale = std::max(distance() - 0.3, 0.0);
-		orange[3] = 1.0 - distance(); // set alpha
-		draw_cube(model_view * gen_trans(position[0], position[1], position[2]) * rot_matrix * scale, orange + point4(color_scale, color_scale, color_scale, 0.0), 0);
+	std::vector<point3> emitters;
+	FireEmitter flames;
+	SmokeEmitter smoke;
+	EmberEmitter embers;
+
+	ParticleSystem()
+		: flames(int(max_particles * max_budget_scale), flame_rate, 1),
+		  smoke(int(max_particles / 2 * max_budget_scale), smoke_rate, 2),
+		  embers(int(max_particles / 2 * max_budget_scale), ember_rate, 3) {
+		set_emitters(std::vector<point3>(1, campfire));
+		apply_budget(1.0);
 	}
 
-	void update(float time_delta) {
-		direction = point3(sin(incline)*sin(theta), cos(incline), sin(incline)*cos(theta));
-		position += speed * direction * time_delta;
-		angular_theta += angular_speed * time_delta;
-		rot_matrix = glm::rotate(rot_matrix, glm::radians(angular_theta), rot_axis);
-	}
-	float distance() {
-		return glm::length(position - glm::vec3(0.0, 0.2, 0.0));
-	}
-	bool past_life() {
-		return distance() > max_distance;
+	void apply_budget(float scale) {
+		flames.set_budget(scale, size_t(max_particles * scale));
+		smoke.set_budget(scale, size_t(max_particles / 2 * scale));
+		embers.set_budget(scale, size_t(max_particles / 2 * scale));
 	}
 
-};
+	size_t size() const { return flames.size() + smoke.size() + embers.size(); }
 
+	void set_emitters(const std::vector<point3> &points) {
+		emitters = points;
+		flames.set_sources(points);
+		smoke.set_sources(points);
+		embers.set_sources(points);
+	}
 
-class ParticleSystem {
-public:
-	int num_particles;
-	Particle *particles;
-
-	ParticleSystem(int num) {
-		num_particles = num;
-		particles = new Particle[num_particles];
-		for (int i = 0; i < num_particles; i++)
-			particles[i] = Particle();
+	// Picks a cube, a billboard or nothing for each particle while filling the draws
+	void draw(const Affine &view, const glm::mat4 &projection) {
+		ParticleLodStats &stats = particle_lod_stats;
+		stats = ParticleLodStats();
+
+		// billboards take the inverse (transpose) of the view rotation to face the camera
+		Affine facing;
+		for (int i = 0; i < 3; i++)
+			facing.rows[i] = glm::vec4(view.rows[0][i], view.rows[1][i], view.rows[2][i], 0.0);
+		float x_scale = projection[0][0], y_scale = projection[1][1];
+		float x_norm = sqrt(1.0 + x_scale * x_scale), y_norm = sqrt(1.0 + y_scale * y_scale);
+		float pixels_at_unit_depth = 0.5 * y_scale * window_height;
+
+		// spin is the axis and angle from spin_at(); the baseline draws every particle as a cube
+		auto draw_particle = [&](const point3 &position, float size, const glm::vec4 &spin, const color4 &color) {
+			if (BaselineRendering()) {
+				stats.cubes++;
+				draw_cube(gen_trans(position.x, position.y, position.z) * gen_scale(size, size, size), color, 0, spin);
+				return;
+			}
+			if (color.a <= 1.0 / 255.0) {
+				stats.culled_transparent++;
+				stats.triangles_saved += 12;
+				return;
+			}
+			glm::vec3 v = view.transform_point(position);
+			float depth = -v.z, radius = 0.87 * size;   // bounding sphere of the cube
+			if (depth < near_plane - radius || depth > far_plane + radius ||
+			    (x_scale * fabs(v.x) - depth) > radius * x_norm || (y_scale * fabs(v.y) - depth) > radius * y_norm) {
+				stats.culled_offscreen++;
+				stats.triangles_saved += 12;
+				return;
+			}
+			if (size * pixels_at_unit_depth >= cube_lod_pixels * depth) {
+				stats.cubes++;
+				draw_cube(gen_trans(position.x, position.y, position.z) * gen_scale(size, size, size), color, 0, spin);
+			} else {
+				// spin in the screen plane
+				stats.billboards++;
+				stats.triangles_saved += 10;
+				Affine model = gen_trans(position.x, position.y, position.z) * facing * gen_scale(size, size, size);
+				submit_draw(quad_mesh, model, color, 0, false, glm::vec4(0.0, 0.0, 1.0, spin.w));
+			}
+		};
+
+		if (flight_playback.active() && flight_particles_recorded()) {
+			const FlightChannels &c = flight_channels;
+			const std::vector<float> &position = flight_playback.values(c.particle_position), &color = flight_playback.values(c.particle_color);
+			const std::vector<float> &spin = flight_playback.values(c.particle_spin), &size = flight_playback.values(c.particle_size);
+			size_t n = size.size();
+			if (position.size() != 3 * n || color.size() != 4 * n || spin.size() != 4 * n)
+				return;
+			for (size_t i = 0; i < n; i++)
+				draw_particle(point3(position[3*i], position[3*i + 1], position[3*i + 2]), size[i],
+				              glm::vec4(spin[4*i], spin[4*i + 1], spin[4*i + 2], spin[4*i + 3]),
+				              color4(color[4*i], color[4*i + 1], color[4*i + 2], color[4*i + 3]));
+			return;
+		}
+
+		auto draw_live = [&](const ParticleState &p, const color4 &color) { draw_particle(p.position, p.size, spin_at(p), color); };
+		smoke.draw(draw_live);
+		flames.draw(draw_live);
+		embers.draw(draw_live);
 	}
 
-	void draw(glm::mat4 model_view) {
-		for (int i = 0; i < num_particles; i++)
-			particles[i].draw(model_view);
+	// The live particles, in the order draw() draws them
+	void record_flight() {
+		static std::vector<float> position, color, spin, size;
+		position.clear();
+		color.clear();
+		spin.clear();
+		size.clear();
+		auto add = [&](const ParticleState &p, const color4 &c) {
+			glm::vec4 s = spin_at(p);
+			position.insert(position.end(), { p.position.x, p.position.y, p.position.z });
+			color.insert(color.end(), { c.r, c.g, c.b, c.a });
+			spin.insert(spin.end(), { s.x, s.y, s.z, s.w });
+			size.push_back(p.size);
+		};
+		smoke.draw(add);
+		flames.draw(add);
+		embers.draw(add);
+		const FlightChannels &c = flight_channels;
+		flight_recorder.record(c.particle_position, position.data(), position.size());
+		flight_recorder.record(c.particle_color, color.data(), color.size());
+		flight_recorder.record(c.particle_spin, spin.data(), spin.size());
+		flight_recorder.record(c.particle_size, size.data(), size.size());
 	}
 
 	void update(float time_delta) {
-		for (int i = 0; i < num_particles; i++)
-			particles[i].update(time_delta);
+		EmitterContext context = { use_fluid ? &fluid : NULL, particle_own_velocity };
+		flames.update(time_delta, context);
+		smoke.update(time_delta, context);
+		embers.update(time_delta, context);
 	}
+};
+ParticleSystem particle_system;
+ParticleBudget particle_budget;
 
-	void dropout() {
-		if (rand() % 2)
-			particles[rand() % num_particles] = Particle();
-	}
+double ms_since(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
 
-	void prune_system() {
-		for (int i = 0; i < num_particles; i++) {
-			if (particles[i].past_life()) {
-				particles[i] = Particle();
-			}
+// Stone, dirt and a grass surface with a ring of trees around the campfire
+void build_campsite(World &world) {
+	int half = world_chunks * CHUNK_SIZE / 2;
+	for (int x = -half; x < half; x++) {
+		for (int z = -half; z < half; z++) {
+			world.set_block(x, 0, z, BLOCK_STONE);
+			for (int y = 1; y < ground_height - 1; y++)
+				world.set_block(x, y, z, BLOCK_DIRT);
+			world.set_block(x, ground_height - 1, z, BLOCK_GRASS);
 		}
 	}
-};
-ParticleSystem particle_system = ParticleSystem(num_particles);
+
+	for (int i = 0; i < num_trees; i++) {
+		float angle = glm::radians(float(rand() % 360));
+		float radius = float(6 + rand() % (half - 8));
+		int tx = int(radius * sin(angle)), tz = int(radius * cos(angle));
+		int trunk = 3 + rand() % 2;
+		tree_bases.push_back(glm::ivec3(tx, ground_height, tz));
+		for (int y = 0; y < trunk; y++)
+			world.set_block(tx, ground_height + y, tz, BLOCK_LOG);
+		for (int y = trunk; y < trunk + 2; y++)
+			for (int dx = -1; dx <= 1; dx++)
+				for (int dz = -1; dz <= 1; dz++)
+					world.set_block(tx + dx, ground_height + y, tz + dz, BLOCK_LEAVES);
+		world.set_block(tx, ground_height + trunk + 2, tz, BLOCK_LEAVES);
+	}
+}
+
+// Advance the fire by whole ticks, clear burnt out blocks and move the particle
+// emitters to the campfire plus the burning blocks
+void update_fire(float dt) {
+	fire_clock += dt;
+	int ticks = 0;
+	static std::vector<glm::ivec3> cells;
+	while (fire_clock >= fire_tick_seconds && ticks < max_fire_ticks_per_frame) {
+		fire.tick();
+		cells.clear();
+		fire.burnt_out_cells(cells);
+		for (const glm::ivec3 &c : cells)
+			world.set_block(c.x, c.y, c.z, BLOCK_AIR);
+		fire_clock -= fire_tick_seconds;
+		ticks++;
+	}
+	if (ticks == max_fire_ticks_per_frame)
+		fire_clock = 0.0;   // fell behind; drop the backlog rather than spiral
+	if (ticks == 0)
+		return;
+
+	cells.clear();
+	fire.burning_cells(cells, max_fire_emitters);
+	std::vector<point3> emitters(1, campfire);
+	for (const glm::ivec3 &c : cells)
+		emitters.push_back(block_to_world.transform_point(glm::vec3(c) + glm::vec3(0.5)));
+	particle_system.set_emitters(emitters);
+}
 
 //----------------------------------------------------------------------------
 
@@ -225,10 +432,22 @@ ParticleSystem particle_system = ParticleSystem(num_particles);
 void
 init()
 {
+   // the driver compiles while the buffers and the world are set up
+   GLuint program = BeginShader( "vshader6.glsl", "fshader5.glsl" );
+   init_flight_channels();
+
    // Create a vertex array object
    GLuint vao = 0;
    glGenVertexArrays( 1, &vao );
    glBindVertexArray( vao );
+   cube_mesh.vao = vao;
+   cube_mesh.first = 0;
+   cube_mesh.count = 36;
+   cube_mesh.bounds = glm::vec4(0.0, 0.0, 0.0, 0.87);
+   quad_mesh.vao = vao;
+   quad_mesh.first = 36;
+   quad_mesh.count = 6;
+   quad_mesh.bounds = glm::vec4(0.0, 0.0, 0.0, 0.71);
 
    GLuint buffer;
 
@@ -244,9 +463,22 @@ init()
    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffer );
    glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW );
 
-   // Load shaders and use the resulting shader program
-   GLuint program = InitShader( "vshader6.glsl", "fshader5.glsl" );
-   glUseProgram( program );
+   block_to_world = gen_trans(0.0, -ground_height * block_size, 0.0) * gen_scale(block_size, block_size, block_size);
+   startup_trace_begin( "build world" );
+   build_campsite(world);
+   startup_trace_end();
+   startup_trace_begin( "fire and fluid" );
+   fire.rules.seed = RandomSeed();
+   fire.build_from(world);
+
+   FluidSettings fluid_settings;
+   fluid_settings.resolution = fluid_resolution;
+   fluid_settings.pressure_iterations = fluid_pressure_iterations;
+   fluid.configure(fluid_settings);
+   startup_trace_end();
+
+   // Wait for the shader program and use it
+   FinishShader( program );
 
    // set up vertex arrays
    GLuint vPosition = glGetAttribLocation( program, "vPosition" );
@@ -257,10 +489,16 @@ init()
    glEnableVertexAttribArray(uv);
    glVertexAttribPointer(uv, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(sizeof(vertices)));
 
-   ModelView = glGetUniformLocation( program, "ModelView" );
-   Projection = glGetUniformLocation( program, "Projection" );
-   SetColor = glGetUniformLocation(program, "SetColor");
-   UseTexture = glGetUniformLocation(program, "UseTexture");
+   startup_trace_begin( "world render" );
+   init_world_render(program);
+   startup_trace_end();
+   init_uniform_blocks(program);
+
+   ParticleBudgetSettings budget_settings;
+   budget_settings.target_ms = target_frame_ms;
+   budget_settings.min_scale = min_budget_scale;
+   budget_settings.max_scale = max_budget_scale;
+   particle_budget = ParticleBudget(budget_settings);
 
    glEnable( GL_DEPTH_TEST );
    glEnable(GL_BLEND);
@@ -272,29 +510,122 @@ init()
 void
 display( void )
 {
+   std::chrono::high_resolution_clock::time_point render_start = std::chrono::high_resolution_clock::now();
    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-   //  Generate the model-view matrix
-   const glm::vec3 viewer_pos( 0.0, 0.5, 2.0 );
-   glm::mat4 trans, rot, scale, model_view;
-   trans = glm::translate(trans, -viewer_pos);
-   rot = gen_rotate(Theta[Xaxis], Theta[Yaxis], Theta[Zaxis]);
-   model_view = trans * rot;
+   if (flight_playback.active()) {
+      curr_time = float(flight_playback.time());
+      if (flight_channels.theta >= 0 && flight_playback.values(flight_channels.theta).size() == NumAxes)
+         std::copy(flight_playback.values(flight_channels.theta).begin(), flight_playback.values(flight_channels.theta).end(), Theta);
+   } else if (flight_recorder.active()) {
+      flight_recorder.record(flight_channels.theta, Theta, NumAxes);
+      particle_system.record_flight();
+   }
 
-   // Floor
-   draw_cube(model_view * gen_scale(1.5, 0.001, 1.5), color4(0.0, 1.0, 0.0, 1.0), 1);
+   //  Generate the view matrix
+   const glm::vec3 viewer_pos( 0.0, 0.5, 2.0 );
+   Affine view = gen_trans(-viewer_pos[0], -viewer_pos[1], -viewer_pos[2]) * gen_rotate(Theta[Xaxis], Theta[Yaxis], Theta[Zaxis]);
+   frame_uniforms.view = view.to_mat4();
+   frame_uniforms.time = glm::vec4(curr_time, 0.0, 0.0, 0.0);
+   set_frame_uniforms(frame_uniforms);
+
+   // Ground
+   update_world_meshes(world, OfflineRendering());
+#ifdef DEBUG
+   // summed until the next report, so editing blocks does not print every frame
+   static long chunks_uploaded = 0, upload_bytes = 0;
+   static double mesh_latency_ms = 0.0, upload_latency_ms = 0.0;
+   chunks_uploaded += world_render_stats.chunks_uploaded;
+   upload_bytes += world_render_stats.upload_bytes;
+   mesh_latency_ms += world_render_stats.mesh_latency_ms * world_render_stats.chunks_uploaded;
+   upload_latency_ms += world_render_stats.upload_latency_ms * world_render_stats.chunks_uploaded;
+#endif
+   draw_world(block_to_world, !BaselineRendering());
 
    // Logs
-   draw_cube(model_view * gen_trans(-0.06, 0.15, 0.0) * gen_rotate(0.0, 0.0, 40.0) * gen_scale(0.5, 0.1, 0.1), brown, 1);
-   draw_cube(model_view * gen_trans(0.06, 0.15, 0.0) * gen_rotate(0.0, 0.0, -40.0) * gen_scale(0.5, 0.1, 0.1), brown, 1);
-   draw_cube(model_view * gen_trans(0.0, 0.15, 0.06) * gen_rotate(40.0, 90.0, 0.0) * gen_scale(0.5, 0.1, 0.1), brown, 1);
-   draw_cube(model_view * gen_trans(0.0, 0.15, -0.06) * gen_rotate(-40.0, 90.0, 0.0) * gen_scale(0.5, 0.1, 0.1), brown, 1);
-
-   particle_system.draw(model_view);
-   particle_system.update(time_delta);
-   particle_system.prune_system();
-
-   glutSwapBuffers();
+   const glm::vec3 log_scale(0.5, 0.1, 0.1);
+   draw_cube(affine_trs(glm::vec3(-0.06, 0.15, 0.0), glm::vec3(0.0, 0.0, 40.0), log_scale), brown, 1);
+   draw_cube(affine_trs(glm::vec3(0.06, 0.15, 0.0), glm::vec3(0.0, 0.0, -40.0), log_scale), brown, 1);
+   draw_cube(affine_trs(glm::vec3(0.0, 0.15, 0.06), glm::vec3(40.0, 90.0, 0.0), log_scale), brown, 1);
+   draw_cube(affine_trs(glm::vec3(0.0, 0.15, -0.06), glm::vec3(-40.0, 90.0, 0.0), log_scale), brown, 1);
+
+   particle_system.draw(view, frame_uniforms.projection);
+   flush_draws(!BaselineRendering());
+   double render_ms = ms_since(render_start);
+#ifdef DEBUG
+   // after flush_draws(), which counts this frame's culling
+   static int frame_count = 0;
+   if (++frame_count % 120 == 0) {
+      const ParticleLodStats &lod = particle_lod_stats;
+      std::cout << "particle lod: " << lod.cubes << " cubes, " << lod.billboards << " billboards, "
+                << lod.culled_transparent << " transparent, " << lod.culled_offscreen << " off screen, "
+                << lod.triangles_saved << " triangles saved" << std::endl;
+      const OcclusionStats &occ = occlusion_buffer.stats();
+      std::cout << "culling: " << cull_stats.tested << " tested, " << cull_stats.culled << " culled, "
+                << cull_stats.occluded << " occluded, " << cull_stats.drawn << " drawn ("
+                << occ.occluders << " occluders, " << occ.raster_ms << " ms), "
+                << world_render_stats.chunks_occluded << " chunks occluded" << std::endl;
+      if (chunks_uploaded > 0)
+         std::cout << "chunks: " << chunks_uploaded << " uploaded, " << upload_bytes << " bytes, "
+                   << world_render_stats.chunks_waiting << " waiting, mesh latency " << mesh_latency_ms / chunks_uploaded
+                   << " ms, upload latency " << upload_latency_ms / chunks_uploaded << " ms" << std::endl;
+      chunks_uploaded = upload_bytes = 0;
+      mesh_latency_ms = upload_latency_ms = 0.0;
+   }
+#endif
+
+   // a replay draws the recorded particles, so there is nothing to simulate
+   std::chrono::high_resolution_clock::time_point sim_start = std::chrono::high_resolution_clock::now();
+   if (!flight_playback.active()) {
+      if (use_fluid) {
+         for (const point3 &emitter : particle_system.emitters)
+            fluid.add_heat(emitter, fluid_source_heat);
+         fluid.step(time_delta);
+      }
+      particle_system.update(time_delta);
+      update_fire(time_delta);
+   }
+   double sim_ms = ms_since(sim_start);
+   frame_stats.add_submit_ms(render_ms);
+   frame_stats.add_sim_ms(sim_ms);
+
+   // the budget follows the measured frame time, which would make offline frames
+   // differ from run to run
+   if (!OfflineRendering() && particle_budget.record(sim_ms, render_ms)) {
+      particle_system.apply_budget(particle_budget.scale());
+#ifdef DEBUG
+      const ParticleBudgetStats &budget = particle_budget.stats();
+      std::cout << "particle budget: scale " << budget.scale << ", " << particle_system.size() << " live, frame "
+                << budget.frame_ms << " ms (sim " << budget.sim_ms << ", render " << budget.render_ms << "), headroom "
+                << budget.headroom_ms << " ms" << std::endl;
+#endif
+   }
+
+   if (hud.visible()) {
+      const ParticleBudgetStats &budget = particle_budget.stats();
+      hud.line("draws %d in %d calls", cull_stats.drawn, cull_stats.batches);
+      hud.line("chunks %d drawn %d occluded", world_render_stats.chunks_drawn, world_render_stats.chunks_occluded);
+      hud.line("particles %d, budget x%.2f", int(particle_system.size()), budget.scale);
+      hud.line("headroom %.1f ms", budget.headroom_ms);
+      hud.draw();
+   }
+
+   // share of the job system's thread time spent in tasks since the last frame
+   static long long last_busy_ns = job_system().busy_time_ns();
+   static std::chrono::high_resolution_clock::time_point last_frame = render_start;
+   long long busy_ns = job_system().busy_time_ns();
+   double wall_ns = ms_since(last_frame) * 1e6 * job_system().num_threads();
+   telemetry.set("job_utilization", wall_ns > 0.0 ? (busy_ns - last_busy_ns) / wall_ns : 0.0);
+   last_busy_ns = busy_ns;
+   last_frame = std::chrono::high_resolution_clock::now();
+
+   telemetry.set("particles", double(particle_system.size()));
+   telemetry.set("particle_budget", particle_budget.scale());
+   telemetry.set("draws", cull_stats.drawn);
+   telemetry.set("draw_calls", cull_stats.batches);
+   telemetry.set("chunks_drawn", world_render_stats.chunks_drawn);
+
+   PresentFrame();
 }
 
 //----------------------------------------------------------------------------
@@ -305,8 +636,29 @@ keyboard( unsigned char key, int x, int y )
     switch( key ) {
        case 033: // Escape Key
        case 'q': case 'Q':
+          frame_capture.stop();
+          frame_stats.stop();
           exit( EXIT_SUCCESS );
           break;
+       case 'r': case 'R': // record frames (see frame_capture.h)
+          if (frame_capture.active())
+             frame_capture.stop();
+          else
+             frame_capture.start(CaptureSettings::from_environment());
+          break;
+       case 'h': case 'H': // performance overlay
+          hud.toggle();
+          break;
+       case 'g': case 'G': // toggle the fluid grid (particles fly straight without it)
+          use_fluid = !use_fluid;
+          fluid.clear();
+          break;
+       case 'f': case 'F': // set a random tree on fire
+          if (!tree_bases.empty()) {
+             glm::ivec3 base = tree_bases[rand() % tree_bases.size()];
+             fire.ignite(base.x, base.y, base.z);
+          }
+          break;
     }
 }
 
@@ -346,10 +698,7 @@ mouse( int button, int state, int x, int y )
 void
 update( void )
 {
-	ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-		std::chrono::system_clock::now().time_since_epoch()).count();
-
-	curr_time = (ms % 1000000) / 1000.0;
+	curr_time = float(FrameTime());
 	time_delta = curr_time - prev_time;
 	prev_time = curr_time;
 
@@ -377,7 +726,6 @@ reshape( int width, int height )
    glViewport( 0, 0, width, height );
 
    GLfloat aspect = GLfloat(width)/height;
-   glm::mat4  projection = glm::perspective(glm::radians(60.0f), aspect, 0.5f, 5.0f);
-
-   glUniformMatrix4fv( Projection, 1, GL_FALSE, glm::value_ptr(projection) );
+   frame_uniforms.projection = glm::perspective(glm::radians(60.0f), aspect, near_plane, far_plane);
+   window_height = height;
 }
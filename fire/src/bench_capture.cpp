@@ -0,0 +1,47 @@
+// Frame capture: the per-frame cost of the copier's copy out of a mapped buffer
+// and of each encoder at 1080p, i.e. how many encoder threads keep up with 60 fps
+//
+//  make bench && ../build/bench_capture
+
+#include "capture_encode.h"
+#include "bench.h"
+
+#include <cmath>
+#include <cstring>
+
+const int width = 1920, height = 1080;
+
+int main() {
+	// something that looks like a frame: smooth gradients and a few hard edges
+	std::vector<unsigned char> rgba(size_t(width) * height * 4);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			unsigned char *p = &rgba[(size_t(y) * width + x) * 4];
+			p[0] = (unsigned char)(x * 255 / width);
+			p[1] = (unsigned char)(y * 255 / height);
+			p[2] = (unsigned char)((x / 64 + y / 64) % 2 ? 200 : 40);
+			p[3] = 255;
+		}
+	}
+
+	std::vector<unsigned char> copy(rgba.size());
+	double copy_ns = bench_ns([&]() {
+		memcpy(&copy[0], &rgba[0], rgba.size());
+		bench_sink = copy[copy.size() / 2];
+	}, 200);
+	bench_report("copy out of the mapped buffer", copy_ns, "frame");
+
+	const CaptureFormat formats[] = { CAPTURE_PPM, CAPTURE_PNG, CAPTURE_YUV };
+	std::vector<unsigned char> out;
+	for (CaptureFormat format : formats) {
+		double ns = bench_ns([&]() {
+			encode_capture(format, &rgba[0], width, height, out);
+			bench_sink = out[out.size() / 2];
+		}, 50);
+		char name[64];
+		snprintf(name, sizeof(name), "encode %s (%.1f MB)", capture_extension(format), out.size() / 1e6);
+		bench_report(name, ns, "frame");
+		printf("%40s %12d encoder threads for 60 fps\n", "", int(ceil(ns * 60.0 / 1e9)));
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+// Block world storage and greedy meshing on a large hilly terrain
+//
+//  make bench && ../build/bench_chunks
+
+#include "chunk.h"
+#include "mesh_pipeline.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+const int world_chunks_xz = 16;
+const int world_chunks_y = 4;
+
+double seconds_since(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void build_terrain(World &world) {
+	int size = world_chunks_xz * CHUNK_SIZE;
+	int top = world_chunks_y * CHUNK_SIZE;
+	for (int x = 0; x < size; x++) {
+		for (int z = 0; z < size; z++) {
+			int height = int(top * (0.5 + 0.2 * sin(x * 0.05) * cos(z * 0.07) + 0.05 * sin(x * 0.3 + z * 0.2)));
+			for (int y = 0; y < height; y++) {
+				BlockId id = y == height - 1 ? BLOCK_GRASS : (y > height - 4 ? BLOCK_DIRT : BLOCK_STONE);
+				world.set_block(x, y, z, id);
+			}
+		}
+	}
+}
+
+int main() {
+	World world;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	build_terrain(world);
+	double fill_s = seconds_since(start);
+
+	std::vector<Chunk *> chunks;
+	world.all_chunks(chunks);
+	long blocks = 0;
+	size_t storage = 0;
+	for (Chunk *chunk : chunks) {
+		storage += chunk->blocks.memory_bytes();
+		for (int i = 0; i < CHUNK_VOLUME; i++)
+			blocks += chunk->blocks.get(i) != BLOCK_AIR;
+	}
+	printf("%d chunks, %ld solid blocks, filled in %.1f ms\n", int(chunks.size()), blocks, fill_s * 1000.0);
+	printf("palette storage %.1f KB (%.2f bits/block, 8 for a plain byte array)\n",
+	       storage / 1024.0, storage * 8.0 / (double(chunks.size()) * CHUNK_VOLUME));
+
+	// mesh everything once
+	static BlockId padded[PADDED_VOLUME];
+	std::vector<BlockVertex> vertices;
+	long quads = 0, faces = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (Chunk *chunk : chunks) {
+		vertices.clear();
+		world.gather_padded(chunk->pos, padded);
+		mesh_chunk(padded, vertices);
+		quads += vertices.size() / 4;
+		for (size_t v = 2; v < vertices.size(); v += 4)
+			faces += long(vertices[v].u) * vertices[v].v;
+	}
+	double mesh_s = seconds_since(start);
+	printf("meshed in %.1f ms (%.1f us/chunk)\n", mesh_s * 1000.0, mesh_s * 1e6 / chunks.size());
+	printf("%ld visible block faces -> %ld greedy quads (%.1fx fewer, %.1f MB of vertices)\n",
+	       faces, quads, double(faces) / quads, quads * 4.0 * sizeof(BlockVertex) / (1024.0 * 1024.0));
+
+	// a single edit only remeshes the touched chunks
+	Chunk *chunk = chunks[chunks.size() / 2];
+	double ns = bench_ns([&]() {
+		int x = chunk->pos.x * CHUNK_SIZE + 5, y = chunk->pos.y * CHUNK_SIZE + 5, z = chunk->pos.z * CHUNK_SIZE + 5;
+		world.set_block(x, y, z, world.get_block(x, y, z) == BLOCK_AIR ? BLOCK_PLANKS : BlockId(BLOCK_AIR));
+		std::vector<Chunk *> dirty;
+		world.take_dirty_chunks(dirty);
+		for (Chunk *c : dirty) {
+			vertices.clear();
+			world.gather_padded(c->pos, padded);
+			mesh_chunk(padded, vertices);
+			c->dirty = false;
+		}
+		bench_sink = float(vertices.size());
+	}, 200);
+	bench_report("edit one block + remesh dirty chunks", ns, "edit");
+
+	// the whole world through the background pipeline, as the GL thread drives it
+	typedef std::chrono::duration<double, std::milli> ms;
+	for (int workers = 1; workers <= 4; workers *= 2) {
+		MeshPipeline pipeline(workers, 64);
+		size_t next = 0, finished = 0;
+		double latency = 0.0, max_latency = 0.0;
+		start = std::chrono::high_resolution_clock::now();
+		while (finished < chunks.size()) {
+			while (next < chunks.size() && pipeline.submit(world, chunks[next]->pos))
+				next++;
+			for (MeshJob *job = pipeline.poll(); job != NULL; job = pipeline.poll()) {
+				double l = ms(job->meshed - job->submitted).count();
+				latency += l;
+				max_latency = std::max(max_latency, l);
+				finished++;
+				pipeline.release(job);
+			}
+		}
+		printf("pipeline, %d worker(s): %.1f ms for the world, latency avg %.2f ms max %.2f ms\n",
+		       workers, seconds_since(start) * 1000.0, latency / chunks.size(), max_latency);
+	}
+	return 0;
+}
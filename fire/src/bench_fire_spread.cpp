@@ -0,0 +1,101 @@
+// Fire spread ticks on a 512^3 block grid, against a byte-per-cell reference
+//
+//  make bench && ../build/bench_fire_spread
+
+#include "fire_spread.h"
+#include "job_system.h"
+#include "bench.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+const int grid_chunks = 32;           // 512^3 blocks
+const int ticks = 20;
+const int reference_size = 128;
+
+double seconds_since(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Everything flammable, about 1 in 8 blocks burning
+void build_grid(FireGrid &fire) {
+	for (int cy = 0; cy < grid_chunks; cy++)
+		for (int cz = 0; cz < grid_chunks; cz++)
+			for (int cx = 0; cx < grid_chunks; cx++) {
+				ChunkPos pos = { cx, cy, cz };
+				FireChunk *chunk = fire.get_or_create(pos);
+				for (int r = 0; r < FIRE_ROWS; r++) {
+					chunk->flammable[r] = 0xFFFF;
+					chunk->burning[0][r] = FireRow(rand() & rand() & rand());
+				}
+				chunk->on_fire = true;
+			}
+}
+
+// The same rules one byte per cell, scalar: 0 = inert, 1 = flammable, 2 = burning
+struct ReferenceGrid {
+	int n;
+	std::vector<uint8_t> cells[2];
+	int current;
+
+	ReferenceGrid(int size) : n(size), current(0) {
+		cells[0].resize(size_t(n) * n * n);
+		cells[1].resize(cells[0].size());
+		for (size_t i = 0; i < cells[0].size(); i++)
+			cells[0][i] = (rand() & rand() & rand() & 1) ? 2 : 1;
+	}
+
+	uint8_t at(int x, int y, int z) const {
+		if (x < 0 || y < 0 || z < 0 || x >= n || y >= n || z >= n)
+			return 0;
+		return cells[current][(size_t(y) * n + z) * n + x];
+	}
+
+	void tick() {
+		std::vector<uint8_t> &next = cells[1 - current];
+		for (int y = 0; y < n; y++)
+			for (int z = 0; z < n; z++)
+				for (int x = 0; x < n; x++) {
+					uint8_t c = at(x, y, z), out = c;
+					if (c == 2 && rand() % 16 == 0)
+						out = 0;
+					else if (c == 1 && (at(x - 1, y, z) == 2 || at(x + 1, y, z) == 2 || at(x, y - 1, z) == 2 ||
+					                    at(x, y + 1, z) == 2 || at(x, y, z - 1) == 2 || at(x, y, z + 1) == 2) && rand() % 4 == 0)
+						out = 2;
+					next[(size_t(y) * n + z) * n + x] = out;
+				}
+		current = 1 - current;
+	}
+};
+
+int main() {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	FireGrid fire;
+	build_grid(fire);
+	double cells = double(grid_chunks * CHUNK_SIZE) * (grid_chunks * CHUNK_SIZE) * (grid_chunks * CHUNK_SIZE);
+	printf("%d chunks (%d^3 blocks), %ld burning, built in %.1f ms, %d thread(s)\n", int(fire.num_chunks()),
+	       grid_chunks * CHUNK_SIZE, fire.num_burning(), seconds_since(start) * 1000.0, job_system().num_threads());
+
+	fire.tick();
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < ticks; i++)
+		fire.tick();
+	double tick_s = seconds_since(start) / ticks;
+	printf("bit-plane tick                           %12.2f ms/tick, %.2f Gcells/s, %d active chunks\n",
+	       tick_s * 1000.0, cells / tick_s * 1e-9, int(fire.num_active_chunks()));
+	printf("%ld burning after %d ticks\n", fire.num_burning(), ticks + 1);
+
+	ReferenceGrid reference(reference_size);
+	reference.tick();
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < 4; i++)
+		reference.tick();
+	double reference_s = seconds_since(start) / 4;
+	double reference_cells = double(reference_size) * reference_size * reference_size;
+	printf("byte-per-cell reference (%d^3)          %12.2f ms/tick, %.2f Gcells/s\n",
+	       reference_size, reference_s * 1000.0, reference_cells / reference_s * 1e-9);
+	printf("speedup %.1fx per cell\n", (cells / tick_s) / (reference_cells / reference_s));
+	bench_sink = float(reference.at(1, 1, 1));
+	return 0;
+}
@@ -0,0 +1,175 @@
+// Flight recorder: the cost of recording a frame of particle state on the render
+// thread, the size on disk against plain floats, the cost of seeking on playback,
+// a check that every value plays back within half a quantum, and what recording a
+// swap-removing particle pool in pool order costs against stable per-particle slots
+//
+//  make bench && ../build/bench_flight_recorder
+
+#include "flight_recorder.h"
+#include "bench.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <unordered_map>
+
+const int particles = 768;
+const int frames = 1200;
+const char *path = "bench_flight_recorder.flight";
+
+// Smooth motion like the fire's: rising, swirling, fading
+static void particle_state(int frame, std::vector<float> &position, std::vector<float> &color, std::vector<float> &size) {
+	float t = frame / 60.0f;
+	position.resize(particles * 3);
+	color.resize(particles * 4);
+	size.resize(particles);
+	for (int i = 0; i < particles; i++) {
+		float age = fmodf(t + i * 0.013f, 1.5f);
+		position[3 * i] = 0.1f * sinf(3.0f * age + i);
+		position[3 * i + 1] = 0.2f + 0.5f * age;
+		position[3 * i + 2] = 0.1f * cosf(2.0f * age + i);
+		color[4 * i] = 1.0f;
+		color[4 * i + 1] = 0.8f - 0.4f * age;
+		color[4 * i + 2] = 0.1f;
+		color[4 * i + 3] = 1.0f - age / 1.5f;
+		size[i] = 0.1f - 0.04f * age;
+	}
+}
+
+// A pool that replaces each dead particle with the last live one, as the emitters
+// do; particles live 1 to 2 s, so they die out of spawn order. Returns the bytes
+// per frame of recording it in pool order, or with each particle at a slot it
+// keeps for life (free slots at size 0, reused by later particles) plus the draw
+// order as slot numbers, which playback needs to blend in the same order.
+static double record_pool(bool slotted) {
+	struct Particle {
+		uint64_t id;
+		int born, life;
+	};
+	FlightRecorder recorder;
+	int position_channel = recorder.add_channel("particles.position", 1e-4f);
+	int size_channel = recorder.add_channel("particles.size", 1e-4f);
+	int order_channel = recorder.add_channel("particles.order", 1.0f);
+	if (!recorder.open(path))
+		return 0.0;
+
+	std::vector<Particle> pool;
+	std::unordered_map<uint64_t, size_t> slots;
+	std::vector<size_t> free_slots;
+	size_t num_slots = 0;
+	std::vector<float> position, size, order;
+	uint64_t next_id = 0;
+	srand(1);
+	for (int f = 0; f < frames; f++) {
+		for (size_t i = 0; i < pool.size(); ) {
+			if (f - pool[i].born >= pool[i].life) {
+				if (slotted) {
+					free_slots.push_back(slots[pool[i].id]);
+					slots.erase(pool[i].id);
+				}
+				pool[i] = pool.back();
+				pool.pop_back();
+			} else {
+				i++;
+			}
+		}
+		while (pool.size() < size_t(particles)) {
+			Particle p = { next_id++, f, 60 + rand() % 60 };
+			if (slotted) {
+				size_t slot = num_slots;
+				if (free_slots.empty()) {
+					num_slots++;
+				} else {
+					slot = free_slots.back();
+					free_slots.pop_back();
+				}
+				slots[p.id] = slot;
+			}
+			pool.push_back(p);
+		}
+
+		position.assign(3 * (slotted ? num_slots : pool.size()), 0.0f);
+		size.assign(slotted ? num_slots : pool.size(), 0.0f);
+		order.clear();
+		for (size_t k = 0; k < pool.size(); k++) {
+			const Particle &p = pool[k];
+			size_t i = slotted ? slots[p.id] : k;
+			float age = (f - p.born) / 60.0f;
+			position[3 * i] = 0.1f * sinf(3.0f * age + p.id);
+			position[3 * i + 1] = 0.2f + 0.5f * age;
+			position[3 * i + 2] = 0.1f * cosf(2.0f * age + p.id);
+			size[i] = 0.1f - 0.04f * age;
+			order.push_back(float(i));
+		}
+
+		recorder.begin_frame(f, f / 60.0);
+		recorder.record(position_channel, &position[0], position.size());
+		recorder.record(size_channel, &size[0], size.size());
+		if (slotted)
+			recorder.record(order_channel, &order[0], order.size());
+		recorder.end_frame();
+	}
+	recorder.close();
+	remove(path);
+	return double(recorder.stats().bytes) / frames;
+}
+
+int main() {
+	int position_channel = flight_recorder.add_channel("particles.position", 1e-4f);
+	int color_channel = flight_recorder.add_channel("particles.color", 1.0f / 255.0f);
+	int size_channel = flight_recorder.add_channel("particles.size", 1e-4f);
+	float theta[3] = { 0.0f, 0.0f, 0.0f };
+	int camera_channel = flight_recorder.add_channel("camera.theta", 0.01f);
+	if (!flight_recorder.open(path)) {
+		printf("cannot create %s\n", path);
+		return 1;
+	}
+
+	std::vector<float> position, color, size;
+	for (int f = 0; f < frames; f++) {
+		particle_state(f, position, color, size);
+		theta[1] = fmodf(0.5f * f, 360.0f);
+		flight_recorder.begin_frame(f, f / 60.0);
+		flight_recorder.record(position_channel, &position[0], position.size());
+		flight_recorder.record(color_channel, &color[0], color.size());
+		flight_recorder.record(size_channel, &size[0], size.size());
+		flight_recorder.record(camera_channel, theta, 3);
+		flight_recorder.end_frame();
+	}
+	flight_recorder.close();
+	FlightRecorderStats stats = flight_recorder.stats();
+
+	if (!flight_playback.open(path)) {
+		printf("cannot map %s\n", path);
+		return 1;
+	}
+	// every frame in order, checking the values
+	float worst = 0.0f;
+	for (int f = 0; f < frames; f++) {
+		flight_playback.seek(f);
+		particle_state(f, position, color, size);
+		const std::vector<float> &played = flight_playback.values(flight_playback.channel("particles.position"));
+		for (size_t i = 0; i < played.size(); i++)
+			worst = std::max(worst, fabsf(played[i] - position[i]) / 1e-4f);
+	}
+	double sequential_ns = bench_ns([&]() {
+		static int f = 0;
+		flight_playback.seek(f);
+		f = (f + 1) % frames;
+	}, frames);
+	double random_ns = bench_ns([&]() {
+		flight_playback.seek(rand() % frames);
+	}, 2000);
+	flight_playback.close();
+	remove(path);
+
+	printf("%d frames of %d particles: %.1f KB per frame, %.1fx smaller than floats; worst error %.2f quanta\n",
+	       frames, particles, stats.bytes / 1024.0 / frames, double(stats.raw_bytes) / stats.bytes, worst);
+	bench_report("record (render thread)", stats.encode_ms * 1e6 / stats.frames, "frame");
+	bench_report("play the next frame", sequential_ns, "frame");
+	bench_report("seek to a random frame", random_ns, "seek");
+
+	double pool_order = record_pool(false), slot_order = record_pool(true);
+	printf("swap-removing pool: %.2f KB per frame in pool order, %.2f KB at stable slots with the draw order\n",
+	       pool_order / 1024.0, slot_order / 1024.0);
+	return worst <= 0.5f + 1e-3f ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+// Fluid grid step cost against its knobs, and the per-particle sampling cost
+//
+//  make bench && ../build/bench_fluid
+
+#include "fluid_grid.h"
+#include "job_system.h"
+#include "bench.h"
+
+#include <cstdlib>
+
+int main() {
+	printf("%d thread(s)\n", job_system().num_threads());
+	const int resolutions[] = { 16, 32, 64 };
+	const int iterations[] = { 10, 20, 40 };
+	for (int resolution : resolutions) {
+		for (int iters : iterations) {
+			FluidSettings settings;
+			settings.resolution = resolution;
+			settings.pressure_iterations = iters;
+			FluidGrid fluid(glm::vec3(-1.6, 0.0, -1.6), glm::vec3(1.6, 1.6, 1.6), settings);
+			double ns = bench_ns([&]() {
+				fluid.add_heat(glm::vec3(0.0, 0.2, 0.0), 60.0f);
+				fluid.step(1.0f / 60.0f);
+			}, resolution >= 64 ? 10 : 60);
+			char name[64];
+			snprintf(name, sizeof(name), "step %dx%dx%d, %d iterations", fluid.dimensions().x, fluid.dimensions().y, fluid.dimensions().z, iters);
+			printf("%-40s %12.3f ms/step\n", name, ns * 1e-6);
+		}
+	}
+
+	FluidGrid fluid(glm::vec3(-1.6, 0.0, -1.6), glm::vec3(1.6, 1.6, 1.6));
+	for (int i = 0; i < 60; i++) {
+		fluid.add_heat(glm::vec3(0.0, 0.2, 0.0), 60.0f);
+		fluid.step(1.0f / 60.0f);
+	}
+	glm::vec3 points[1024];
+	for (glm::vec3 &p : points)
+		p = glm::vec3(rand() % 100 * 0.01f - 0.5f, rand() % 100 * 0.01f, rand() % 100 * 0.01f - 0.5f);
+	int k = 0;
+	bench_report("velocity_at (one particle)", bench_ns([&]() {
+		bench_sink = bench_sink + fluid.velocity_at(points[k++ & 1023]).y;
+	}, 2000000), "particle");
+	return 0;
+}
@@ -0,0 +1,76 @@
+// Frame-time statistics: the cost of recording a frame, and the histogram
+// percentiles against the exact ones of a jittery frame-time distribution
+//
+//  make bench && ../build/bench_frame_stats
+
+#include "frame_stats.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+int main() {
+	// exports go next to the benchmark rather than into the source directory
+	setenv("FRAME_STATS", "../build/bench_frame_stats", 0);
+
+	// mostly 16.7 ms frames, with a tail of hitches
+	std::mt19937 rng(7);
+	std::normal_distribution<float> steady(16.7f, 0.8f);
+	std::exponential_distribution<float> hitch(1.0f / 20.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const int frames = 200000;
+	std::vector<float> totals(frames);
+	for (float &ms : totals)
+		ms = std::max(0.1f, steady(rng)) + (unit(rng) < 0.02f ? hitch(rng) : 0.0f);
+
+	FrameHistogram histogram;
+	for (float ms : totals)
+		histogram.add(ms);
+	std::vector<float> sorted = totals;
+	std::sort(sorted.begin(), sorted.end());
+	const double fractions[] = { 0.50, 0.95, 0.99 };
+	for (double fraction : fractions) {
+		float exact = sorted[size_t(fraction * frames) - 1];
+		float estimate = histogram.percentile(fraction);
+		printf("p%-3d exact %8.3f ms, histogram %8.3f ms (%+.2f%%)\n", int(fraction * 100 + 0.5), exact, estimate,
+		       100.0 * (estimate - exact) / exact);
+	}
+	printf("max  exact %8.3f ms, histogram %8.3f ms\n", sorted.back(), histogram.max_ms());
+
+	// the render thread's side: bursts that fit the ring, with pauses for the
+	// collector (which drains every 100 ms) in between
+	frame_stats.start(1.0);
+	const int rounds = 20, burst = FrameStats::RING_SIZE / 2;
+	double record_ns = 0.0;
+	int next = 0;
+	for (int round = 0; round < rounds; round++) {
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < burst; i++) {
+			frame_stats.add_sim_ms(1.0);
+			frame_stats.add_submit_ms(2.0);
+			frame_stats.end_frame(3.0, totals[next]);
+			next = (next + 1) % frames;
+		}
+		record_ns += std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+	}
+	record_ns /= rounds * burst;
+	double add_ns = bench_ns([&]() {
+		histogram.add(totals[next]);
+		next = (next + 1) % frames;
+	}, 1000000);
+	double percentile_ns = bench_ns([&]() { bench_sink = histogram.percentile(0.99); }, 100000);
+	frame_stats.stop();
+
+	FrameStatsSummary summary = frame_stats.summary();
+	printf("collector: %u frames recorded, %u dropped; total p99 over the run %.3f ms\n", summary.frames,
+	       summary.dropped, summary.run[FRAME_TOTAL].p99);
+	bench_report("record a frame", record_ns, "frame");
+	bench_report("histogram add", add_ns, "sample");
+	bench_report("histogram p99", percentile_ns, "query");
+	return 0;
+}
@@ -0,0 +1,111 @@
+// Occlusion culling of chunks on a large hilly terrain, seen from a low camera
+//
+//  make bench && ../build/bench_occlusion
+
+#include "chunk.h"
+#include "frustum.h"
+#include "occlusion.h"
+#include "bench.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <vector>
+
+const int world_chunks_xz = 16;
+const int world_chunks_y = 4;
+
+// What world_render keeps per chunk
+struct ChunkBox {
+	glm::vec3 origin;
+	glm::vec3 lo, hi;        // bounds of the mesh, in world units
+	int solid_lo, solid_hi;
+	bool empty;
+};
+
+int terrain_height(int x, int z) {
+	int top = world_chunks_y * CHUNK_SIZE;
+	return int(top * (0.5 + 0.2 * sin(x * 0.05) * cos(z * 0.07) + 0.05 * sin(x * 0.3 + z * 0.2)));
+}
+
+void build_terrain(World &world) {
+	int size = world_chunks_xz * CHUNK_SIZE;
+	for (int x = 0; x < size; x++) {
+		for (int z = 0; z < size; z++) {
+			int height = terrain_height(x, z);
+			for (int y = 0; y < height; y++) {
+				BlockId id = y == height - 1 ? BLOCK_GRASS : (y > height - 4 ? BLOCK_DIRT : BLOCK_STONE);
+				world.set_block(x, y, z, id);
+			}
+		}
+	}
+}
+
+int main() {
+	World world;
+	build_terrain(world);
+
+	std::vector<Chunk *> chunks;
+	world.all_chunks(chunks);
+	std::vector<ChunkBox> boxes;
+	static BlockId padded[PADDED_VOLUME];
+	std::vector<BlockVertex> vertices;
+	int occluder_chunks = 0;
+	for (Chunk *chunk : chunks) {
+		ChunkBox box;
+		box.origin = glm::vec3(chunk->pos.x, chunk->pos.y, chunk->pos.z) * float(CHUNK_SIZE);
+		world.gather_padded(chunk->pos, padded);
+		vertices.clear();
+		mesh_chunk(padded, vertices);
+		box.empty = !mesh_bounds(vertices, box.lo, box.hi);
+		box.lo += box.origin;
+		box.hi += box.origin;
+		occluder_chunks += opaque_layers(padded, box.solid_lo, box.solid_hi);
+		boxes.push_back(box);
+	}
+
+	// standing on the terrain at one corner, looking across it
+	glm::vec3 eye(24.0f, terrain_height(24, 24) + 2.0f, 24.0f);
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.5f, 400.0f);
+	glm::mat4 view = glm::lookAt(eye, glm::vec3(200.0f, eye.y - 4.0f, 180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 view_projection = projection * view;
+	Frustum frustum = frustum_from_matrix(view_projection);
+
+	OcclusionBuffer buffer;
+	auto rasterize = [&]() {
+		buffer.begin(view_projection);
+		for (const ChunkBox &box : boxes)
+			if (box.solid_hi > box.solid_lo)
+				buffer.add_occluder_box(affine_translate(box.origin.x, box.origin.y, box.origin.z),
+				                        glm::vec3(0, box.solid_lo, 0), glm::vec3(CHUNK_SIZE, box.solid_hi, CHUNK_SIZE));
+	};
+	int drawable = 0, in_frustum = 0, occluded = 0;
+	auto test = [&]() {
+		drawable = in_frustum = occluded = 0;
+		for (const ChunkBox &box : boxes) {
+			if (box.empty)
+				continue;
+			drawable++;
+			if (!frustum_test_sphere(frustum, 0.5f * (box.lo + box.hi), 0.5f * glm::length(box.hi - box.lo)))
+				continue;
+			in_frustum++;
+			occluded += !buffer.test_box(box.lo, box.hi);
+		}
+	};
+
+	double raster_ns = bench_ns(rasterize, 50);
+	rasterize();
+	test();          // builds the pyramid once
+	const OcclusionStats stats = buffer.stats();
+	double test_ns = bench_ns(test, 200);
+
+	printf("%d chunks, %d with faces, %d usable as occluders\n", int(chunks.size()), drawable, occluder_chunks);
+	printf("%d in the frustum, %d of those occluded (%.1f%% culling efficiency), %d drawn\n",
+	       in_frustum, occluded, 100.0 * occluded / in_frustum, in_frustum - occluded);
+	printf("%d occluders, %d triangles into a %dx%d buffer\n", stats.occluders, stats.triangles,
+	       buffer.buffer_width(), buffer.buffer_height());
+	bench_report("rasterize occluders", raster_ns, "frame");
+	bench_report("rasterize + pyramid (one frame)", stats.raster_ms * 1e6, "frame");
+	bench_report("frustum + occlusion test", test_ns / drawable, "chunk");
+	return 0;
+}
@@ -0,0 +1,151 @@
+// Fused policy emitter against the same modules configured at run time
+//
+//  make bench && ../build/bench_particles
+
+#include "particle_emitter.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <vector>
+
+const int num_particles = 16384;
+const float rate_per_source = 300.0f;    // roughly keeps the pool full at 64 sources
+
+// The runtime-configured equivalent: one virtual call per module per particle
+struct SpawnModule { virtual ~SpawnModule() {} virtual void spawn(ParticleState &p, const glm::vec3 &source, ParticleRng &rng) const = 0; };
+struct VelocityModule { virtual ~VelocityModule() {} virtual glm::vec3 launch(const ParticleState &p, ParticleRng &rng) const = 0; };
+struct ForceModule { virtual ~ForceModule() {} virtual glm::vec3 drift(ParticleState &p, const EmitterContext &context, float dt) const = 0; };
+struct ColorModule { virtual ~ColorModule() {} virtual glm::vec4 color(const ParticleState &p) const = 0; };
+struct KillModule { virtual ~KillModule() {} virtual bool dead(const ParticleState &p) const = 0; };
+
+template <class P> struct SpawnAdapter : SpawnModule {
+	void spawn(ParticleState &p, const glm::vec3 &source, ParticleRng &rng) const { P::spawn(p, source, rng); }
+};
+template <class P> struct VelocityAdapter : VelocityModule {
+	glm::vec3 launch(const ParticleState &p, ParticleRng &rng) const { return P::launch(p, rng); }
+};
+template <class P> struct ForceAdapter : ForceModule {
+	glm::vec3 drift(ParticleState &p, const EmitterContext &context, float dt) const { return P::drift(p, context, dt); }
+};
+template <class P> struct ColorAdapter : ColorModule {
+	glm::vec4 color(const ParticleState &p) const { return P::color(p); }
+};
+template <class P> struct KillAdapter : KillModule {
+	bool dead(const ParticleState &p) const { return P::dead(p); }
+};
+
+// Same pool, compaction and emission as Emitter
+struct RuntimeEmitter {
+	std::vector<ParticleState> pool;
+	size_t live;
+	std::vector<glm::vec3> sources;
+	float rate, emit_debt;
+	ParticleRng rng;
+	const SpawnModule *spawn;
+	const VelocityModule *velocity;
+	const ForceModule *force;
+	const ColorModule *color;
+	const KillModule *kill;
+
+	void spawn_batch(size_t count) {
+		size_t n = std::min(count, pool.size() - live);
+		for (size_t i = live; i < live + n; i++) {
+			spawn->spawn(pool[i], sources[rng.below(int(sources.size()))], rng);
+			pool[i].velocity = velocity->launch(pool[i], rng);
+		}
+		live += n;
+	}
+
+	void update(float dt, const EmitterContext &context) {
+		for (size_t i = 0; i < live; i++) {
+			pool[i].position += force->drift(pool[i], context, dt) * dt;
+			pool[i].age += dt;
+		}
+		for (size_t i = 0; i < live; ) {
+			if (kill->dead(pool[i]))
+				pool[i] = pool[--live];
+			else
+				i++;
+		}
+		emit_debt += rate * float(sources.size()) * dt;
+		size_t count = size_t(emit_debt);
+		emit_debt -= float(count);
+		spawn_batch(count);
+	}
+
+	template <class F>
+	void draw(F f) const {
+		for (size_t i = 0; i < live; i++)
+			f(pool[i], color->color(pool[i]));
+	}
+};
+
+// Chosen at run time so the compiler cannot see through the virtual calls
+static volatile int configuration = 0;
+
+RuntimeEmitter make_runtime_fire(float rate) {
+	RuntimeEmitter emitter;
+	emitter.live = 0;
+	emitter.rate = rate;
+	emitter.emit_debt = 0.0f;
+	static SpawnAdapter<FlameSpawn> flame_spawn;
+	static SpawnAdapter<SmokeSpawn> smoke_spawn;
+	static VelocityAdapter<ConeVelocity<50, 150, 35> > flame_velocity;
+	static VelocityAdapter<ConeVelocity<10, 30, 20> > smoke_velocity;
+	static ForceAdapter<FlowForce> flow;
+	static ForceAdapter<EmberForce> ember_force;
+	static ColorAdapter<FlameColor> flame_color;
+	static ColorAdapter<SmokeColor> smoke_color;
+	static KillAdapter<DistanceKill> distance_kill;
+	static KillAdapter<AgeKill> age_kill;
+	bool fire = configuration == 0;
+	emitter.spawn = fire ? (SpawnModule *)&flame_spawn : &smoke_spawn;
+	emitter.velocity = fire ? (VelocityModule *)&flame_velocity : &smoke_velocity;
+	emitter.force = fire ? (ForceModule *)&flow : &ember_force;
+	emitter.color = fire ? (ColorModule *)&flame_color : &smoke_color;
+	emitter.kill = fire ? (KillModule *)&distance_kill : &age_kill;
+	return emitter;
+}
+
+int main() {
+	std::vector<glm::vec3> sources;
+	for (int i = 0; i < 64; i++)
+		sources.push_back(glm::vec3(i % 8, 0.0f, i / 8));
+
+	FireEmitter fused(num_particles, rate_per_source);
+	fused.set_sources(sources);
+	fused.spawn_batch(num_particles);
+
+	RuntimeEmitter runtime = make_runtime_fire(rate_per_source);
+	runtime.sources = sources;
+	runtime.pool.resize(num_particles);
+	runtime.spawn_batch(num_particles);
+
+	EmitterContext context = { NULL, 0.3f };
+	float sum = 0.0f;
+	auto accumulate = [&](const ParticleState &, const glm::vec4 &color) { sum += color.a; };
+
+	double fused_ns = bench_ns([&]() { fused.update(1.0f / 60.0f, context); fused.draw(accumulate); }, 400);
+	double runtime_ns = bench_ns([&]() { runtime.update(1.0f / 60.0f, context); runtime.draw(accumulate); }, 400);
+	bench_report("fire emitter, fused policies", fused_ns / num_particles, "particle");
+	bench_report("fire emitter, virtual modules", runtime_ns / num_particles, "particle");
+
+	FluidGrid fluid(glm::vec3(-1.0, 0.0, -1.0), glm::vec3(9.0, 4.0, 9.0));
+	context.fluid = &fluid;
+	fused_ns = bench_ns([&]() { fused.update(1.0f / 60.0f, context); fused.draw(accumulate); }, 200);
+	runtime_ns = bench_ns([&]() { runtime.update(1.0f / 60.0f, context); runtime.draw(accumulate); }, 200);
+	bench_report("fire emitter + flow, fused policies", fused_ns / num_particles, "particle");
+	bench_report("fire emitter + flow, virtual modules", runtime_ns / num_particles, "particle");
+
+	FireEmitter spawner(num_particles, 0.0f);
+	spawner.set_sources(sources);
+	double spawn_ns = bench_ns([&]() {
+		spawner.clear();
+		spawner.spawn_batch(num_particles);
+	}, 200);
+	bench_report("spawn_batch", spawn_ns / num_particles, "particle");
+	printf("live particles at the end: fused %d, runtime %d\n", int(fused.size()), int(runtime.live));
+
+	bench_sink = sum;
+	return 0;
+}
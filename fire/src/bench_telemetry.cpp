@@ -0,0 +1,68 @@
+// Telemetry: the cost of publishing a frame's counters while a reader polls the
+// block as fast as it can, and a check that the reader never sees a torn copy
+//
+//  make bench && ../build/bench_telemetry
+
+#include "telemetry.h"
+#include "bench.h"
+
+#include <atomic>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+const int counters = 12;
+const char *counter_names[counters] = {
+	"frame_ms", "frame_p99_ms", "sim_ms", "submit_ms", "gpu_ms", "job_utilization",
+	"particles", "particle_budget", "draws", "draw_calls", "chunks_drawn", "chunks_occluded",
+};
+
+int main() {
+	if (!telemetry.open()) {
+		printf("shared memory is not available\n");
+		return 1;
+	}
+
+	// every counter of a frame holds the same value, so a torn copy shows up as a mismatch
+	double value = 0.0;
+	auto publish = [&]() {
+		value += 1.0;
+		for (int i = 0; i < counters; i++)
+			telemetry.set(counter_names[i], value);
+		telemetry.publish();
+	};
+	publish();
+
+	std::atomic<bool> done(false);
+	long reads = 0, failed = 0, torn = 0;
+	std::thread reader([&]() {
+		int fd = shm_open(telemetry.name(), O_RDONLY, 0);
+		const TelemetryBlock *block = (const TelemetryBlock *)mmap(NULL, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		TelemetrySnapshot snapshot;
+		while (!done.load(std::memory_order_relaxed)) {
+			if (!telemetry_read(block, snapshot)) {
+				failed++;
+				continue;
+			}
+			reads++;
+			for (uint32_t i = 1; i < snapshot.counters; i++)
+				torn += snapshot.values[i] != snapshot.values[0];
+		}
+		munmap((void *)block, sizeof(TelemetryBlock));
+	});
+
+	double quiet_ns = 0.0;
+	double contended_ns = bench_ns(publish, 2000000);
+	done = true;
+	reader.join();
+	quiet_ns = bench_ns(publish, 2000000);
+	telemetry.close();
+
+	printf("%d counters; reader took %ld copies (%ld gave up), %ld torn values\n", counters, reads, failed, torn);
+	bench_report("set + publish, reader polling", contended_ns, "frame");
+	bench_report("set + publish, no reader", quiet_ns, "frame");
+	return torn == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// Affine 3x4 transforms vs. the glm::mat4 chains they replaced, for the fire scene:
+// a floor, four logs and a cloud of particles, each built as translate * rotate * scale
+//
+//  make bench && ../build/bench_transforms
+
+#include "affine.h"
+#include "bench.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+const int num_particles = 4096;
+
+// The glm versions of gen_rotate/gen_trans/gen_scale from before the switch to Affine
+glm::mat4 glm_rotate(float rot_x, float rot_y, float rot_z) {
+	glm::mat4 rotate;
+	rotate = glm::rotate(rotate, glm::radians(rot_x), glm::vec3(1, 0, 0));
+	rotate = glm::rotate(rotate, glm::radians(rot_y), glm::vec3(0, 1, 0));
+	rotate = glm::rotate(rotate, glm::radians(rot_z), glm::vec3(0, 0, 1));
+	return rotate;
+}
+
+glm::mat4 glm_trans(float x, float y, float z) {
+	return glm::translate(glm::mat4(), glm::vec3(x, y, z));
+}
+
+glm::mat4 glm_scale(float x, float y, float z) {
+	return glm::scale(glm::mat4(), glm::vec3(x, y, z));
+}
+
+struct BenchParticle {
+	glm::vec3 position, rotation;
+};
+
+int main() {
+	std::vector<BenchParticle> particles(num_particles);
+	for (BenchParticle &p : particles) {
+		p.position = glm::vec3(rand() % 100, rand() % 100, rand() % 100) * 0.01f;
+		p.rotation = glm::vec3(rand() % 360, rand() % 360, rand() % 360);
+	}
+
+	std::vector<glm::mat4> glm_out(num_particles);
+	std::vector<Affine> affine_out(num_particles), local(num_particles);
+	glm::mat4 glm_view = glm_trans(0.0, -0.5, -2.0) * glm_rotate(20.0, 30.0, 0.0);
+	Affine view = affine_translate(0.0, -0.5, -2.0) * affine_rotate(20.0, 30.0, 0.0);
+	glm::mat4 glm_particle_scale = glm_scale(0.1, 0.1, 0.1);
+	Affine particle_scale = affine_scale(0.1, 0.1, 0.1);
+
+	printf("fire scene, %d particles + 5 static blocks\n", num_particles);
+
+	// logs: view * translate * rotate * scale
+	double ns = bench_ns([&]() {
+		glm::mat4 m = glm_view * glm_trans(-0.06, 0.15, 0.0) * glm_rotate(0.0, 0.0, 40.0) * glm_scale(0.5, 0.1, 0.1);
+		bench_sink = m[3][0];
+	}, 1000000);
+	bench_report("log  glm::mat4 chain", ns);
+	ns = bench_ns([&]() {
+		Affine m = view * affine_translate(-0.06, 0.15, 0.0) * affine_rotate(0.0, 0.0, 40.0) * affine_scale(0.5, 0.1, 0.1);
+		bench_sink = m.rows[0].w;
+	}, 1000000);
+	bench_report("log  Affine chain", ns);
+	ns = bench_ns([&]() {
+		Affine m = view * affine_trs(glm::vec3(-0.06, 0.15, 0.0), glm::vec3(0.0, 0.0, 40.0), glm::vec3(0.5, 0.1, 0.1));
+		bench_sink = m.rows[0].w;
+	}, 1000000);
+	bench_report("log  Affine fused TRS", ns);
+
+	// particles: view * translate * rotation * scale, per frame
+	ns = bench_ns([&]() {
+		for (int i = 0; i < num_particles; i++) {
+			const BenchParticle &p = particles[i];
+			glm_out[i] = glm_view * glm_trans(p.position.x, p.position.y, p.position.z) * glm_rotate(p.rotation.x, p.rotation.y, p.rotation.z) * glm_particle_scale;
+		}
+		bench_sink = glm_out[num_particles - 1][3][0];
+	}, 200);
+	bench_report("particles  glm::mat4 chain", ns / num_particles, "particle");
+	ns = bench_ns([&]() {
+		for (int i = 0; i < num_particles; i++) {
+			const BenchParticle &p = particles[i];
+			affine_out[i] = view * affine_translate(p.position.x, p.position.y, p.position.z) * affine_rotate(p.rotation.x, p.rotation.y, p.rotation.z) * particle_scale;
+		}
+		bench_sink = affine_out[num_particles - 1].rows[0].w;
+	}, 200);
+	bench_report("particles  Affine chain", ns / num_particles, "particle");
+	ns = bench_ns([&]() {
+		for (int i = 0; i < num_particles; i++) {
+			const BenchParticle &p = particles[i];
+			local[i] = affine_trs(p.position, p.rotation, glm::vec3(0.1f));
+		}
+		affine_compose_n(view, &local[0], &affine_out[0], num_particles);
+		bench_sink = affine_out[num_particles - 1].rows[0].w;
+	}, 200);
+	bench_report("particles  Affine fused TRS + batch", ns / num_particles, "particle");
+
+	printf("upload size per transform: mat4 %u bytes, Affine %u bytes\n", unsigned(sizeof(glm::mat4)), unsigned(sizeof(Affine)));
+	return 0;
+}
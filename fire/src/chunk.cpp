@@ -0,0 +1,280 @@
+// Chunked block world: palette storage, world access and greedy meshing
+
+#include "chunk.h"
+
+#include <algorithm>
+#include <cstring>
+
+const BlockInfo block_info[NUM_BLOCK_TYPES] = {
+	{ glm::vec4(0.0, 0.0, 0.0, 0.0), false, false },   // air
+	{ glm::vec4(0.0, 1.0, 0.0, 1.0), true, false },    // grass
+	{ glm::vec4(0.5, 0.35, 0.2, 1.0), true, false },   // dirt
+	{ glm::vec4(0.55, 0.55, 0.55, 1.0), true, false }, // stone
+	{ glm::vec4(0.6, 0.3, 0.0, 1.0), true, true },     // log
+	{ glm::vec4(0.1, 0.6, 0.1, 1.0), true, true },     // leaves
+	{ glm::vec4(0.8, 0.6, 0.3, 1.0), true, true },     // planks
+};
+
+//----------------------------------------------------------------------------
+
+PaletteStorage::PaletteStorage() : bits(0) {
+	palette.push_back(BLOCK_AIR);
+}
+
+void PaletteStorage::grow() {
+	int new_bits = bits == 0 ? 1 : bits * 2;
+	std::vector<uint32_t> new_words(CHUNK_VOLUME * new_bits / 32, 0);
+	for (int i = 0; i < CHUNK_VOLUME; i++) {
+		uint32_t p = 0;
+		if (bits != 0) {
+			int bit = i * bits;
+			p = (words[bit >> 5] >> (bit & 31)) & ((1u << bits) - 1);
+		}
+		int new_bit = i * new_bits;
+		new_words[new_bit >> 5] |= p << (new_bit & 31);
+	}
+	words.swap(new_words);
+	bits = new_bits;
+}
+
+void PaletteStorage::set(int index, BlockId id) {
+	uint32_t p = 0;
+	while (p < palette.size() && palette[p] != id)
+		p++;
+	if (p == palette.size()) {
+		palette.push_back(id);
+		while (palette.size() > (1u << bits))
+			grow();
+	}
+	if (bits == 0)
+		return;
+
+	int bit = index * bits;
+	uint32_t mask = ((1u << bits) - 1) << (bit & 31);
+	words[bit >> 5] = (words[bit >> 5] & ~mask) | (p << (bit & 31));
+}
+
+//----------------------------------------------------------------------------
+
+World::~World() {
+	for (auto &entry : chunks)
+		delete entry.second;
+}
+
+Chunk *World::chunk_at(ChunkPos pos) const {
+	auto it = chunks.find(pos);
+	return it == chunks.end() ? NULL : it->second;
+}
+
+Chunk *World::get_or_create_chunk(ChunkPos pos) {
+	Chunk *&chunk = chunks[pos];
+	if (chunk == NULL) {
+		chunk = new Chunk(pos);
+		dirty_queue.push_back(chunk);
+	}
+	return chunk;
+}
+
+BlockId World::get_block(int x, int y, int z) const {
+	ChunkPos pos = { chunk_coord(x), chunk_coord(y), chunk_coord(z) };
+	Chunk *chunk = chunk_at(pos);
+	if (chunk == NULL)
+		return BLOCK_AIR;
+	return chunk->blocks.get(block_index(local_coord(x), local_coord(y), local_coord(z)));
+}
+
+void World::set_block(int x, int y, int z, BlockId id) {
+	ChunkPos pos = { chunk_coord(x), chunk_coord(y), chunk_coord(z) };
+	int lx = local_coord(x), ly = local_coord(y), lz = local_coord(z);
+	Chunk *chunk = get_or_create_chunk(pos);
+	chunk->blocks.set(block_index(lx, ly, lz), id);
+	mark_dirty(chunk);
+
+	// faces on a chunk border belong to the neighbour's mesh as well
+	const int edge = CHUNK_SIZE - 1;
+	int local[3] = { lx, ly, lz };
+	for (int axis = 0; axis < 3; axis++) {
+		if (local[axis] != 0 && local[axis] != edge)
+			continue;
+		ChunkPos n = pos;
+		int step = local[axis] == 0 ? -1 : 1;
+		if (axis == 0) n.x += step;
+		if (axis == 1) n.y += step;
+		if (axis == 2) n.z += step;
+		Chunk *neighbour = chunk_at(n);
+		if (neighbour != NULL)
+			mark_dirty(neighbour);
+	}
+}
+
+void World::gather_padded(ChunkPos pos, BlockId *padded) const {
+	Chunk *around[3][3][3];
+	for (int dy = -1; dy <= 1; dy++)
+		for (int dz = -1; dz <= 1; dz++)
+			for (int dx = -1; dx <= 1; dx++) {
+				ChunkPos n = { pos.x + dx, pos.y + dy, pos.z + dz };
+				around[dy + 1][dz + 1][dx + 1] = chunk_at(n);
+			}
+
+	for (int y = -1; y <= CHUNK_SIZE; y++) {
+		int cy = y < 0 ? 0 : (y < CHUNK_SIZE ? 1 : 2);
+		int ly = y - (cy - 1) * CHUNK_SIZE;
+		for (int z = -1; z <= CHUNK_SIZE; z++) {
+			int cz = z < 0 ? 0 : (z < CHUNK_SIZE ? 1 : 2);
+			int lz = z - (cz - 1) * CHUNK_SIZE;
+			for (int x = -1; x <= CHUNK_SIZE; x++) {
+				int cx = x < 0 ? 0 : (x < CHUNK_SIZE ? 1 : 2);
+				int lx = x - (cx - 1) * CHUNK_SIZE;
+				const Chunk *chunk = around[cy][cz][cx];
+				padded[padded_index(x, y, z)] = chunk ? chunk->blocks.get(block_index(lx, ly, lz)) : BlockId(BLOCK_AIR);
+			}
+		}
+	}
+}
+
+void World::mark_dirty(Chunk *chunk) {
+	if (chunk->dirty)
+		return;    // already queued
+	chunk->dirty = true;
+	dirty_queue.push_back(chunk);
+}
+
+void World::take_dirty_chunks(std::vector<Chunk *> &out) {
+	out.insert(out.end(), dirty_queue.begin(), dirty_queue.end());
+	dirty_queue.clear();
+}
+
+void World::all_chunks(std::vector<Chunk *> &out) const {
+	for (auto &entry : chunks)
+		out.push_back(entry.second);
+}
+
+//----------------------------------------------------------------------------
+
+// Fixed per-direction shading so merged faces keep some depth cue: [axis][positive]
+static const float face_shade[3][2] = {
+	{ 0.7f, 0.8f },   // -x, +x
+	{ 0.5f, 1.0f },   // -y, +y
+	{ 0.6f, 0.9f },   // -z, +z
+};
+
+static void emit_quad(std::vector<BlockVertex> &vertices, int d, int u, int v, bool positive,
+                      int plane, int i, int j, int w, int h, BlockId id) {
+	glm::vec4 color = block_info[id].color * face_shade[d][positive ? 1 : 0];
+	BlockVertex vertex;
+	vertex.pad0 = vertex.pad1 = vertex.pad2 = 0;
+	vertex.r = uint8_t(color.r * 255.0f);
+	vertex.g = uint8_t(color.g * 255.0f);
+	vertex.b = uint8_t(color.b * 255.0f);
+	vertex.a = uint8_t(block_info[id].color.a * 255.0f);
+
+	// corners as (offset along u, offset along v), counter-clockwise seen from outside
+	const int ccw[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	for (int k = 0; k < 4; k++) {
+		int cu = positive ? ccw[k][0] : ccw[k][1];
+		int cv = positive ? ccw[k][1] : ccw[k][0];
+		uint8_t c[3];
+		c[d] = uint8_t(plane);
+		c[u] = uint8_t(i + cu * w);
+		c[v] = uint8_t(j + cv * h);
+		vertex.x = c[0];
+		vertex.y = c[1];
+		vertex.z = c[2];
+		vertex.u = uint8_t(cu * w);
+		vertex.v = uint8_t(cv * h);
+		vertices.push_back(vertex);
+	}
+}
+
+void mesh_chunk(const BlockId *padded, std::vector<BlockVertex> &vertices) {
+	BlockId mask[CHUNK_AREA];
+
+	for (int d = 0; d < 3; d++) {
+		int u = (d + 1) % 3, v = (d + 2) % 3;
+		int step[3] = { 0, 0, 0 };
+
+		for (int side = 0; side < 2; side++) {
+			bool positive = side == 1;
+			step[d] = positive ? 1 : -1;
+
+			for (int s = 0; s < CHUNK_SIZE; s++) {
+				// visible faces of this slice
+				int c[3];
+				c[d] = s;
+				for (int j = 0; j < CHUNK_SIZE; j++) {
+					c[v] = j;
+					for (int i = 0; i < CHUNK_SIZE; i++) {
+						c[u] = i;
+						BlockId block = padded[padded_index(c[0], c[1], c[2])];
+						BlockId neighbour = padded[padded_index(c[0] + step[0], c[1] + step[1], c[2] + step[2])];
+						bool visible = block != BLOCK_AIR && !block_info[neighbour].opaque && neighbour != block;
+						mask[j * CHUNK_SIZE + i] = visible ? block : BlockId(BLOCK_AIR);
+					}
+				}
+
+				// merge into rectangles, widest first
+				int plane = positive ? s + 1 : s;
+				for (int j = 0; j < CHUNK_SIZE; j++) {
+					for (int i = 0; i < CHUNK_SIZE; ) {
+						BlockId id = mask[j * CHUNK_SIZE + i];
+						if (id == BLOCK_AIR) {
+							i++;
+							continue;
+						}
+						int w = 1;
+						while (i + w < CHUNK_SIZE && mask[j * CHUNK_SIZE + i + w] == id)
+							w++;
+						int h = 1;
+						for (; j + h < CHUNK_SIZE; h++) {
+							int k = 0;
+							while (k < w && mask[(j + h) * CHUNK_SIZE + i + k] == id)
+								k++;
+							if (k < w)
+								break;
+						}
+
+						emit_quad(vertices, d, u, v, positive, plane, i, j, w, h, id);
+
+						for (int y = 0; y < h; y++)
+							memset(&mask[(j + y) * CHUNK_SIZE + i], BLOCK_AIR, w);
+						i += w;
+					}
+				}
+			}
+		}
+	}
+}
+
+bool mesh_bounds(const std::vector<BlockVertex> &vertices, glm::vec3 &lo, glm::vec3 &hi) {
+	uint8_t l[3] = { CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE }, h[3] = { 0, 0, 0 };
+	for (const BlockVertex &v : vertices) {
+		const uint8_t p[3] = { v.x, v.y, v.z };
+		for (int k = 0; k < 3; k++) {
+			l[k] = std::min(l[k], p[k]);
+			h[k] = std::max(h[k], p[k]);
+		}
+	}
+	lo = glm::vec3(l[0], l[1], l[2]);
+	hi = glm::vec3(h[0], h[1], h[2]);
+	return !vertices.empty();
+}
+
+bool opaque_layers(const BlockId *padded, int &lo, int &hi) {
+	int best_lo = 0, best_hi = 0, run_lo = 0;
+	for (int y = 0; y <= CHUNK_SIZE; y++) {
+		bool solid = y < CHUNK_SIZE;
+		for (int z = 0; z < CHUNK_SIZE && solid; z++)
+			for (int x = 0; x < CHUNK_SIZE && solid; x++)
+				solid = block_info[padded[padded_index(x, y, z)]].opaque;
+		if (solid)
+			continue;
+		if (y - run_lo > best_hi - best_lo) {
+			best_lo = run_lo;
+			best_hi = y;
+		}
+		run_lo = y + 1;
+	}
+	lo = best_lo;
+	hi = best_hi;
+	return hi > lo;
+}
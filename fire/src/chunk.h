@@ -0,0 +1,163 @@
+// Chunked block world
+//
+// Blocks live in 16^3 chunks. Each chunk stores a small palette of the block types
+// it contains and a bit-packed array of palette indices (0, 1, 2, 4 or 8 bits per
+// block), so uniform chunks cost a single byte and typical terrain chunks 1-2 KB.
+// Chunks are turned into geometry with greedy meshing: hidden faces are dropped
+// and coplanar faces of the same block type are merged into larger quads.
+
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+const int CHUNK_SIZE = 16;
+const int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// A chunk plus a one block border taken from its neighbours
+const int PADDED_SIZE = CHUNK_SIZE + 2;
+const int PADDED_VOLUME = PADDED_SIZE * PADDED_SIZE * PADDED_SIZE;
+
+typedef uint8_t BlockId;
+
+enum {
+	BLOCK_AIR = 0,
+	BLOCK_GRASS,
+	BLOCK_DIRT,
+	BLOCK_STONE,
+	BLOCK_LOG,
+	BLOCK_LEAVES,
+	BLOCK_PLANKS,
+	NUM_BLOCK_TYPES
+};
+
+struct BlockInfo {
+	glm::vec4 color;
+	bool opaque;
+	bool flammable;
+};
+
+extern const BlockInfo block_info[NUM_BLOCK_TYPES];
+
+// Bit-packed palette indices for one chunk
+class PaletteStorage {
+	std::vector<BlockId> palette;
+	std::vector<uint32_t> words;
+	int bits;                     // bits per block; 0 while the chunk holds a single type
+
+	void grow();
+
+public:
+	PaletteStorage();
+
+	BlockId get(int index) const {
+		if (bits == 0)
+			return palette[0];
+		int bit = index * bits;
+		return palette[(words[bit >> 5] >> (bit & 31)) & ((1u << bits) - 1)];
+	}
+
+	void set(int index, BlockId id);
+
+	int bits_per_block() const { return bits; }
+	size_t memory_bytes() const { return palette.size() + words.size() * sizeof(uint32_t); }
+};
+
+struct ChunkPos {
+	int x, y, z;
+};
+
+inline bool operator==(const ChunkPos &a, const ChunkPos &b) {
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+struct ChunkPosHash {
+	size_t operator()(const ChunkPos &p) const {
+		return (size_t(uint32_t(p.x)) * 73856093u) ^ (size_t(uint32_t(p.y)) * 19349663u) ^ (size_t(uint32_t(p.z)) * 83492791u);
+	}
+};
+
+inline int block_index(int x, int y, int z) {
+	return (y * CHUNK_SIZE + z) * CHUNK_SIZE + x;
+}
+
+inline int padded_index(int x, int y, int z) {
+	return ((y + 1) * PADDED_SIZE + (z + 1)) * PADDED_SIZE + (x + 1);
+}
+
+struct Chunk {
+	ChunkPos pos;
+	PaletteStorage blocks;
+	bool dirty;            // queued by World until the caller of take_dirty_chunks() clears it
+
+	Chunk(ChunkPos p) : pos(p), dirty(true) {}
+};
+
+class World {
+	std::unordered_map<ChunkPos, Chunk *, ChunkPosHash> chunks;
+	std::vector<Chunk *> dirty_queue;    // each chunk once, when it became dirty
+
+public:
+	World() {}
+	~World();
+
+	Chunk *chunk_at(ChunkPos pos) const;
+	Chunk *get_or_create_chunk(ChunkPos pos);
+
+	// Block coordinates are global; missing chunks read as air
+	BlockId get_block(int x, int y, int z) const;
+	void set_block(int x, int y, int z, BlockId id);
+
+	// Copies a chunk and its one block border into a PADDED_VOLUME array (see padded_index)
+	void gather_padded(ChunkPos pos, BlockId *padded) const;
+
+	// Appends the chunks that became dirty since the last call, without scanning the
+	// world. A chunk is queued again only after its dirty flag has been cleared, so
+	// the caller keeps the ones it cannot remesh yet.
+	void take_dirty_chunks(std::vector<Chunk *> &out);
+	void all_chunks(std::vector<Chunk *> &out) const;
+	size_t num_chunks() const { return chunks.size(); }
+
+private:
+	void mark_dirty(Chunk *chunk);
+
+	World(const World &);
+	World &operator=(const World &);
+};
+
+// Integer division/modulo that round towards negative infinity
+inline int chunk_coord(int block) {
+	return block >= 0 ? block / CHUNK_SIZE : (block + 1) / CHUNK_SIZE - 1;
+}
+
+inline int local_coord(int block) {
+	return block - chunk_coord(block) * CHUNK_SIZE;
+}
+
+// 12 bytes per vertex: positions and uvs are block units inside the chunk (0..16)
+struct BlockVertex {
+	uint8_t x, y, z, pad0;
+	uint8_t u, v, pad1, pad2;
+	uint8_t r, g, b, a;
+};
+
+// Greedy mesh of a padded chunk; appends 4 vertices per quad, to be drawn with a
+// shared quad index buffer (0 1 2, 0 2 3 per quad)
+void mesh_chunk(const BlockId *padded, std::vector<BlockVertex> &vertices);
+
+// Bounding box of the vertices of a chunk mesh, in block units; false when empty
+bool mesh_bounds(const std::vector<BlockVertex> &vertices, glm::vec3 &lo, glm::vec3 &hi);
+
+// The longest run of y layers [lo, hi) of a padded chunk that are completely
+// opaque, for use as an occluder; false when there is none
+bool opaque_layers(const BlockId *padded, int &lo, int &hi);
+
+// Worst case quad count (a 3D checkerboard)
+const int MAX_CHUNK_QUADS = CHUNK_VOLUME / 2 * 6;
+
+#endif // CHUNK_H
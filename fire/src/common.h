@@ -19,6 +19,27 @@
 
 extern GLuint InitShader(const char* vShaderFile, const char* fShaderFile);
 
+// InitShader() in two halves, so other start-up work can overlap the compile
+extern GLuint BeginShader(const char* vShaderFile, const char* fShaderFile);
+extern GLuint FinishShader(GLuint program);
+// Never blocks: false while the driver is still compiling, so more start-up work
+// can be done before FinishShader(); always true without parallel compiles
+extern bool ShaderReady(GLuint program);
+
+// Call at the end of display() instead of glutSwapBuffers(); captures the frame
+// when recording
+extern void PresentFrame(void);
+
+// Seconds since the main loop started. Rendering offline (see main.cpp) it is the
+// frame number over the frame rate instead, so every run animates identically.
+extern double FrameTime(void);
+// Seed for the demos' random numbers: 1 unless set with --seed
+extern unsigned RandomSeed(void);
+extern bool OfflineRendering(void);
+// --baseline: draw as before the rendering optimizations, i.e. without culling and
+// at one level of detail, as the reference the optimized frames are checked against
+extern bool BaselineRendering(void);
+
 // Implement the following...
 
 extern const char *WINDOW_TITLE;
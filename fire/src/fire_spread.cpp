@@ -0,0 +1,244 @@
+// Cellular-automaton fire spreading across flammable blocks
+
+#include "fire_spread.h"
+#include "job_system.h"
+
+// 32 random bits per (seed, tick, chunk, row, stream)
+static inline uint32_t row_hash(uint32_t seed, uint32_t row) {
+	uint32_t h = seed ^ (row * 0x9E3779B1u);
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h;
+}
+
+// 16 bits that are each set with probability sixteenths / 16
+static inline FireRow chance_mask(uint32_t seed, uint32_t row, unsigned sixteenths) {
+	if (sixteenths >= 16)
+		return 0xFFFF;
+	uint32_t a = row_hash(seed, row * 2), b = row_hash(seed, row * 2 + 1);
+	uint32_t r[4] = { a & 0xFFFF, a >> 16, b & 0xFFFF, b >> 16 };
+	// bit-serial comparison of a 4-bit random number against sixteenths
+	uint32_t m = 0;
+	for (int i = 0; i < 4; i++)
+		m = (sixteenths >> i) & 1 ? (m | r[i]) : (m & r[i]);
+	return FireRow(m);
+}
+
+static inline unsigned to_sixteenths(float chance) {
+	if (chance <= 0.0f)
+		return 0;
+	if (chance >= 1.0f)
+		return 16;
+	return unsigned(chance * 16.0f + 0.5f);
+}
+
+//----------------------------------------------------------------------------
+
+FireGrid::FireGrid() : tick_count(0) {
+	rules.ignite_chance = 0.25f;
+	rules.burnout_chance = 0.0625f;
+	rules.seed = 1;
+}
+
+FireGrid::~FireGrid() {
+	for (FireChunk *chunk : all)
+		delete chunk;
+}
+
+FireChunk *FireGrid::find(ChunkPos pos) const {
+	auto it = chunks.find(pos);
+	return it == chunks.end() ? NULL : it->second;
+}
+
+FireChunk *FireGrid::get_or_create(ChunkPos pos) {
+	FireChunk *&chunk = chunks[pos];
+	if (chunk == NULL) {
+		chunk = new FireChunk();      // value-initialized: all planes clear
+		chunk->pos = pos;
+		all.push_back(chunk);
+	}
+	return chunk;
+}
+
+void FireGrid::set_flammable(int x, int y, int z, bool flammable) {
+	ChunkPos pos = { chunk_coord(x), chunk_coord(y), chunk_coord(z) };
+	FireChunk *chunk = flammable ? get_or_create(pos) : find(pos);
+	if (chunk == NULL)
+		return;
+	FireRow bit = FireRow(1u << local_coord(x));
+	int row = local_coord(y) * CHUNK_SIZE + local_coord(z);
+	if (flammable)
+		chunk->flammable[row] |= bit;
+	else {
+		chunk->flammable[row] &= ~bit;
+		chunk->burning[chunk->current][row] &= ~bit;
+	}
+}
+
+void FireGrid::ignite(int x, int y, int z) {
+	ChunkPos pos = { chunk_coord(x), chunk_coord(y), chunk_coord(z) };
+	FireChunk *chunk = find(pos);
+	if (chunk == NULL)
+		return;
+	FireRow bit = FireRow(1u << local_coord(x));
+	int row = local_coord(y) * CHUNK_SIZE + local_coord(z);
+	if (chunk->flammable[row] & bit) {
+		chunk->burning[chunk->current][row] |= bit;
+		chunk->on_fire = true;
+	}
+}
+
+bool FireGrid::is_burning(int x, int y, int z) const {
+	ChunkPos pos = { chunk_coord(x), chunk_coord(y), chunk_coord(z) };
+	FireChunk *chunk = find(pos);
+	if (chunk == NULL)
+		return false;
+	return (chunk->live()[local_coord(y) * CHUNK_SIZE + local_coord(z)] >> local_coord(x)) & 1;
+}
+
+void FireGrid::build_from(const World &world) {
+	std::vector<Chunk *> world_chunks;
+	world.all_chunks(world_chunks);
+	for (Chunk *chunk : world_chunks) {
+		for (int y = 0; y < CHUNK_SIZE; y++)
+			for (int z = 0; z < CHUNK_SIZE; z++)
+				for (int x = 0; x < CHUNK_SIZE; x++)
+					if (block_info[chunk->blocks.get(block_index(x, y, z))].flammable)
+						set_flammable(chunk->pos.x * CHUNK_SIZE + x, chunk->pos.y * CHUNK_SIZE + y, chunk->pos.z * CHUNK_SIZE + z, true);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// Burning chunks and their face neighbours are the only ones that can change
+void FireGrid::collect_active() {
+	for (FireChunk *chunk : all)
+		chunk->ticked = false;
+	active.clear();
+	for (FireChunk *chunk : all) {
+		if (!chunk->on_fire)
+			continue;
+		static const int offsets[7][3] = { { 0, 0, 0 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+		for (int i = 0; i < 7; i++) {
+			ChunkPos n = { chunk->pos.x + offsets[i][0], chunk->pos.y + offsets[i][1], chunk->pos.z + offsets[i][2] };
+			FireChunk *neighbour = i == 0 ? chunk : find(n);
+			if (neighbour != NULL && !neighbour->ticked) {
+				neighbour->ticked = true;
+				active.push_back(neighbour);
+			}
+		}
+	}
+}
+
+void FireGrid::tick_chunk(FireChunk &chunk, unsigned ignite_sixteenths, unsigned burnout_sixteenths) {
+	static const FireRow empty[FIRE_ROWS] = { 0 };
+	const int S = CHUNK_SIZE;
+	ChunkPos p = chunk.pos;
+	ChunkPos xn = { p.x - 1, p.y, p.z }, xp = { p.x + 1, p.y, p.z };
+	ChunkPos yn = { p.x, p.y - 1, p.z }, yp = { p.x, p.y + 1, p.z };
+	ChunkPos zn = { p.x, p.y, p.z - 1 }, zp = { p.x, p.y, p.z + 1 };
+	const FireChunk *around[6] = { find(xn), find(xp), find(yn), find(yp), find(zn), find(zp) };
+	const FireRow *planes[6];
+	for (int i = 0; i < 6; i++)
+		planes[i] = around[i] ? around[i]->live() : empty;
+
+	// live plane with a one row border in y and z taken from the neighbours, and the
+	// x neighbours' edge bits shifted into place
+	FireRow padded[S + 2][S + 2];
+	FireRow carry[FIRE_ROWS];
+	const FireRow *live = chunk.live();
+	for (int y = -1; y <= S; y++) {
+		for (int z = -1; z <= S; z++) {
+			FireRow row = 0;
+			if (y >= 0 && y < S && z >= 0 && z < S)
+				row = live[y * S + z];
+			else if (y < 0 && z >= 0 && z < S)
+				row = planes[2][(S - 1) * S + z];
+			else if (y >= S && z >= 0 && z < S)
+				row = planes[3][z];
+			else if (z < 0 && y >= 0 && y < S)
+				row = planes[4][y * S + S - 1];
+			else if (z >= S && y >= 0 && y < S)
+				row = planes[5][y * S];
+			padded[y + 1][z + 1] = row;
+		}
+	}
+	for (int r = 0; r < FIRE_ROWS; r++)
+		carry[r] = FireRow(((planes[0][r] >> (S - 1)) & 1) | ((planes[1][r] & 1) << (S - 1)));
+
+	uint32_t seed = rules.seed * 0x27D4EB2Fu ^ uint32_t(tick_count) * 0x165667B1u;
+	uint32_t chunk_seed = seed ^ uint32_t(ChunkPosHash()(p));
+	uint32_t ignite_seed = chunk_seed, burnout_seed = chunk_seed ^ 0x5BD1E995u;
+
+	FireRow *next = chunk.burning[1 - chunk.current];
+	FireRow any = 0;
+	for (int y = 0; y < S; y++) {
+		for (int z = 0; z < S; z++) {
+			int r = y * S + z;
+			FireRow b = padded[y + 1][z + 1];
+			FireRow near = FireRow((b << 1) | (b >> 1) | carry[r]
+				| padded[y][z + 1] | padded[y + 2][z + 1] | padded[y + 1][z] | padded[y + 1][z + 2]);
+			FireRow burnt = b & chance_mask(burnout_seed, r, burnout_sixteenths);
+			FireRow lit = chunk.flammable[r] & ~b & near & chance_mask(ignite_seed, r, ignite_sixteenths);
+			chunk.flammable[r] &= ~burnt;
+			chunk.burnt_out[r] = burnt;
+			next[r] = FireRow((b & ~burnt) | lit);
+			any |= next[r];
+		}
+	}
+	chunk.on_fire = any != 0;
+}
+
+void FireGrid::tick() {
+	collect_active();
+	unsigned ignite = to_sixteenths(rules.ignite_chance), burnout = to_sixteenths(rules.burnout_chance);
+
+	job_system().parallel_for(int(active.size()), 4, [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			tick_chunk(*active[i], ignite, burnout);
+	});
+
+	// publish the new planes only once every chunk has read its neighbours' old ones
+	for (FireChunk *chunk : active)
+		chunk->current = 1 - chunk->current;
+	tick_count++;
+}
+
+//----------------------------------------------------------------------------
+
+static void append_cells(const FireChunk &chunk, const FireRow *rows, std::vector<glm::ivec3> &out, size_t limit) {
+	for (int r = 0; r < FIRE_ROWS && out.size() < limit; r++) {
+		for (unsigned bits = rows[r]; bits != 0 && out.size() < limit; bits &= bits - 1) {
+			int x = 0;
+			while (!((bits >> x) & 1))
+				x++;
+			out.push_back(glm::ivec3(chunk.pos.x * CHUNK_SIZE + x, chunk.pos.y * CHUNK_SIZE + r / CHUNK_SIZE, chunk.pos.z * CHUNK_SIZE + r % CHUNK_SIZE));
+		}
+	}
+}
+
+void FireGrid::burning_cells(std::vector<glm::ivec3> &out, size_t limit) const {
+	for (FireChunk *chunk : all)
+		if (chunk->on_fire)
+			append_cells(*chunk, chunk->live(), out, limit);
+}
+
+void FireGrid::burnt_out_cells(std::vector<glm::ivec3> &out) const {
+	for (FireChunk *chunk : active)
+		append_cells(*chunk, chunk->burnt_out, out, size_t(-1));
+}
+
+long FireGrid::num_burning() const {
+	long count = 0;
+	for (FireChunk *chunk : all) {
+		if (!chunk->on_fire)
+			continue;
+		for (int r = 0; r < FIRE_ROWS; r++)
+			for (unsigned bits = chunk->live()[r]; bits != 0; bits &= bits - 1)
+				count++;
+	}
+	return count;
+}
@@ -0,0 +1,84 @@
+// Cellular-automaton fire spreading across flammable blocks
+//
+// Fire state is kept per chunk as bit planes: one 16-bit row per (y, z) holds the
+// 16 blocks along x, for "flammable" and for "burning" (double-buffered). A tick is
+// a stencil over whole rows with shifts, ANDs and ORs, so the inner loops are
+// branch-free and vectorize, and chunks are processed in parallel on the job system.
+//
+// Rules, per tick:
+//   - a flammable block next to a burning one (6-neighbourhood) ignites with
+//     probability ignite_chance
+//   - a burning block burns out with probability burnout_chance; it stops being
+//     flammable and is reported so the world can turn it into air
+// Randomness is a hash of (seed, tick, chunk, row), so a run is reproducible and
+// independent of the thread count.
+
+#ifndef FIRE_SPREAD_H
+#define FIRE_SPREAD_H
+
+#include "chunk.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+typedef uint16_t FireRow;
+const int FIRE_ROWS = CHUNK_SIZE * CHUNK_SIZE;     // rows are indexed y * 16 + z
+
+struct FireChunk {
+	ChunkPos pos;
+	FireRow flammable[FIRE_ROWS];
+	FireRow burning[2][FIRE_ROWS];    // burning[current] is the live plane
+	FireRow burnt_out[FIRE_ROWS];     // blocks that burnt out in the last tick
+	int current;
+	bool on_fire;                     // any bit set in burning[current]
+	bool ticked;                      // part of the last tick's active set
+
+	const FireRow *live() const { return burning[current]; }
+};
+
+struct FireRules {
+	float ignite_chance;              // per tick, quantized to 1/16
+	float burnout_chance;             // per tick, quantized to 1/16
+	unsigned seed;
+};
+
+class FireGrid {
+	std::unordered_map<ChunkPos, FireChunk *, ChunkPosHash> chunks;
+	std::vector<FireChunk *> all, active;
+	unsigned long tick_count;
+
+	FireChunk *find(ChunkPos pos) const;
+	void collect_active();
+	void tick_chunk(FireChunk &chunk, unsigned ignite_sixteenths, unsigned burnout_sixteenths);
+
+	FireGrid(const FireGrid &);
+	FireGrid &operator=(const FireGrid &);
+
+public:
+	FireRules rules;
+
+	FireGrid();
+	~FireGrid();
+
+	// Chunks are created on demand; only chunks with flammable blocks need one
+	FireChunk *get_or_create(ChunkPos pos);
+	void set_flammable(int x, int y, int z, bool flammable);
+	void ignite(int x, int y, int z);
+	bool is_burning(int x, int y, int z) const;
+
+	// Marks every flammable block of the world
+	void build_from(const World &world);
+
+	void tick();
+
+	// Global block coordinates of cells that are burning / burnt out in the last tick
+	void burning_cells(std::vector<glm::ivec3> &out, size_t limit) const;
+	void burnt_out_cells(std::vector<glm::ivec3> &out) const;
+
+	size_t num_chunks() const { return all.size(); }
+	size_t num_active_chunks() const { return active.size(); }
+	long num_burning() const;
+};
+
+#endif // FIRE_SPREAD_H
@@ -0,0 +1,392 @@
+// Simulation flight recorder
+
+#include "flight_recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+FlightRecorder flight_recorder;
+FlightPlayback flight_playback;
+
+static const char flight_magic[8] = { 'B', 'A', 'F', 'L', 'I', 'G', 'H', 'T' };
+static const char flight_index_magic[8] = "BAFLIDX";
+
+static void append(std::vector<unsigned char> &out, const void *data, size_t bytes) {
+	const unsigned char *p = (const unsigned char *)data;
+	out.insert(out.end(), p, p + bytes);
+}
+
+// At most 10 bytes
+static inline void put_varint(unsigned char *&out, uint64_t value) {
+	while (value >= 0x80) {
+		*out++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (unsigned char)value;
+}
+
+// false when the varint runs past end
+static bool get_varint(const unsigned char *&p, const unsigned char *end, uint64_t &value) {
+	value = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7) {
+		unsigned char byte = *p++;
+		value |= uint64_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static inline uint64_t zigzag(int64_t value) {
+	return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value) {
+	return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+static inline int32_t quantize(float value, float inverse_quantum) {
+	float q = std::floor(value * inverse_quantum + 0.5f);
+	return q >= 2147483520.0f ? 2147483647 : q <= -2147483648.0f ? int32_t(-2147483647 - 1) : int32_t(q);
+}
+
+//----------------------------------------------------------------------------
+// Recording
+
+FlightRecorder::FlightRecorder() : file(NULL), frame(0), time(0.0), since_key(0), stopping(false) {
+	memset(&current, 0, sizeof(current));
+}
+
+FlightRecorder::~FlightRecorder() {
+	close();
+}
+
+int FlightRecorder::add_channel(const char *name, float quantum) {
+	Channel channel;
+	memset(&channel.info, 0, sizeof(channel.info));
+	strncpy(channel.info.name, name, FLIGHT_NAME_LENGTH - 1);
+	channel.info.quantum = quantum;
+	channels.push_back(channel);
+	return int(channels.size()) - 1;
+}
+
+bool FlightRecorder::open(const char *path) {
+	if (file != NULL)
+		return true;
+	file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	memset(&current, 0, sizeof(current));
+	index.clear();
+	since_key = 0;
+	for (Channel &channel : channels)
+		channel.previous.clear();
+
+	block.clear();
+	block.reserve(BLOCK_BYTES + BLOCK_BYTES / 4);
+	FlightHeader header;
+	memcpy(header.magic, flight_magic, sizeof(header.magic));
+	header.version = FLIGHT_VERSION;
+	header.channels = uint32_t(channels.size());
+	append(block, &header, sizeof(header));
+	for (const Channel &channel : channels)
+		append(block, &channel.info, sizeof(channel.info));
+	current.bytes = block.size();
+
+	stopping = false;
+	writer = std::thread(&FlightRecorder::write_loop, this);
+	return true;
+}
+
+void FlightRecorder::close() {
+	if (file == NULL)
+		return;
+
+	FlightTrailer trailer;
+	trailer.index_offset = current.bytes;
+	trailer.entries = index.size();
+	memcpy(trailer.magic, flight_index_magic, sizeof(trailer.magic));
+	if (!index.empty())
+		append(block, &index[0], index.size() * sizeof(index[0]));
+	append(block, &trailer, sizeof(trailer));
+	hand_off_block();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	block_ready.notify_one();
+	writer.join();
+	fclose(file);
+	file = NULL;
+}
+
+void FlightRecorder::begin_frame(long f, double t) {
+	frame = f;
+	time = t;
+	for (Channel &channel : channels)
+		channel.values.clear();
+}
+
+void FlightRecorder::record(int channel, const float *values, size_t count) {
+	if (file == NULL || channel < 0 || channel >= int(channels.size()))
+		return;
+	channels[channel].values.assign(values, values + count);
+}
+
+void FlightRecorder::end_frame() {
+	if (file == NULL)
+		return;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	bool key = since_key == 0;
+	since_key = (since_key + 1) % KEY_INTERVAL;
+
+	FlightIndexEntry entry = { int64_t(frame), current.bytes, key ? 1u : 0u, 0 };
+	index.push_back(entry);
+
+	// the header goes in first and gets its size once the channels are encoded
+	size_t at = block.size();
+	block.resize(at + sizeof(FlightChunk));
+	for (Channel &channel : channels) {
+		size_t count = channel.values.size();
+		size_t used = block.size();
+		block.resize(used + (count + 1) * 10);
+		unsigned char *out = &block[used];
+		put_varint(out, count);
+
+		float inverse_quantum = 1.0f / channel.info.quantum;
+		size_t deltas = key ? 0 : std::min(count, channel.previous.size());
+		channel.previous.resize(count);
+		int32_t *previous = channel.previous.empty() ? NULL : &channel.previous[0];
+		const float *values = channel.values.empty() ? NULL : &channel.values[0];
+		for (size_t i = 0; i < count; i++) {
+			int32_t q = quantize(values[i], inverse_quantum);
+			put_varint(out, zigzag(int64_t(q) - (i < deltas ? previous[i] : 0)));
+			previous[i] = q;
+		}
+		block.resize(out - &block[0]);
+		current.raw_bytes += count * sizeof(float);
+	}
+
+	FlightChunk chunk;
+	chunk.magic = FLIGHT_CHUNK_MAGIC;
+	chunk.bytes = uint32_t(block.size() - at - sizeof(FlightChunk));
+	chunk.frame = int64_t(frame);
+	chunk.time = time;
+	chunk.key = key ? 1 : 0;
+	chunk.reserved = 0;
+	memcpy(&block[at], &chunk, sizeof(chunk));
+
+	current.bytes += block.size() - at;
+	current.raw_bytes += sizeof(FlightChunk);
+	current.frames++;
+	current.key_frames += key;
+	if (block.size() >= BLOCK_BYTES)
+		hand_off_block();
+	current.encode_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Queues the block for the writer and starts a new one
+void FlightRecorder::hand_off_block() {
+	if (block.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		full_blocks.push_back(std::vector<unsigned char>());
+		full_blocks.back().swap(block);
+		if (!spare_blocks.empty()) {
+			block.swap(spare_blocks.back());
+			spare_blocks.pop_back();
+		}
+	}
+	block_ready.notify_one();
+	block.clear();
+	block.reserve(BLOCK_BYTES + BLOCK_BYTES / 4);
+}
+
+void FlightRecorder::write_loop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		block_ready.wait(lock, [&]() { return stopping || !full_blocks.empty(); });
+		if (full_blocks.empty())
+			return;
+		std::vector<unsigned char> data;
+		data.swap(full_blocks.front());
+		full_blocks.pop_front();
+		lock.unlock();
+
+		fwrite(&data[0], 1, data.size(), file);
+
+		lock.lock();
+		data.clear();
+		spare_blocks.push_back(std::vector<unsigned char>());
+		spare_blocks.back().swap(data);
+	}
+}
+
+//----------------------------------------------------------------------------
+// Playback
+
+FlightPlayback::FlightPlayback() : data(NULL), size(0), position(-1), current_time(0.0) {
+}
+
+FlightPlayback::~FlightPlayback() {
+	close();
+}
+
+bool FlightPlayback::open(const char *path) {
+#ifdef _WIN32
+	return false;
+#else
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	void *memory = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size >= off_t(sizeof(FlightHeader)))
+		memory = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED)
+		return false;
+	data = (const unsigned char *)memory;
+	size = size_t(info.st_size);
+
+	FlightHeader header;
+	memcpy(&header, data, sizeof(header));
+	size_t start = sizeof(header) + size_t(header.channels) * sizeof(FlightChannel);
+	if (memcmp(header.magic, flight_magic, sizeof(header.magic)) != 0 || header.version != FLIGHT_VERSION ||
+	    start > size) {
+		close();
+		return false;
+	}
+	channels.resize(header.channels);
+	for (uint32_t i = 0; i < header.channels; i++) {
+		memcpy(&channels[i].info, data + sizeof(header) + i * sizeof(FlightChannel), sizeof(FlightChannel));
+		channels[i].info.name[FLIGHT_NAME_LENGTH - 1] = '\0';
+	}
+
+	if (!read_index())
+		rebuild_index(start);
+	return true;
+#endif
+}
+
+void FlightPlayback::close() {
+#ifndef _WIN32
+	if (data != NULL)
+		munmap((void *)data, size);
+#endif
+	data = NULL;
+	size = 0;
+	channels.clear();
+	index.clear();
+	position = -1;
+	current_time = 0.0;
+}
+
+int FlightPlayback::channel(const char *name) const {
+	for (size_t i = 0; i < channels.size(); i++)
+		if (strcmp(channels[i].info.name, name) == 0)
+			return int(i);
+	return -1;
+}
+
+// The index that close() wrote; false when there is none
+bool FlightPlayback::read_index() {
+	FlightTrailer trailer;
+	if (size < sizeof(trailer))
+		return false;
+	memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+	if (memcmp(trailer.magic, flight_index_magic, sizeof(trailer.magic)) != 0 ||
+	    trailer.index_offset + trailer.entries * sizeof(FlightIndexEntry) != size - sizeof(trailer))
+		return false;
+	index.resize(size_t(trailer.entries));
+	if (!index.empty())
+		memcpy(&index[0], data + trailer.index_offset, index.size() * sizeof(index[0]));
+	return true;
+}
+
+// Walks the chunks up to the first incomplete one
+void FlightPlayback::rebuild_index(size_t offset) {
+	index.clear();
+	while (offset + sizeof(FlightChunk) <= size) {
+		FlightChunk chunk;
+		memcpy(&chunk, data + offset, sizeof(chunk));
+		if (chunk.magic != FLIGHT_CHUNK_MAGIC || offset + sizeof(chunk) + chunk.bytes > size)
+			break;
+		FlightIndexEntry entry = { chunk.frame, offset, chunk.key, 0 };
+		index.push_back(entry);
+		offset += sizeof(chunk) + chunk.bytes;
+	}
+	// deltas after the last key frame are useless without the frames before it
+	if (!index.empty() && !index.front().key)
+		index.clear();
+}
+
+bool FlightPlayback::seek(long target) {
+	if (index.empty())
+		return false;
+	// the last entry at or before target
+	FlightIndexEntry probe = { int64_t(target), 0, 0, 0 };
+	std::vector<FlightIndexEntry>::const_iterator it = std::upper_bound(index.begin(), index.end(), probe,
+		[](const FlightIndexEntry &a, const FlightIndexEntry &b) { return a.frame < b.frame; });
+	long entry = it == index.begin() ? 0 : long(it - index.begin()) - 1;
+	if (entry == position)
+		return true;
+
+	long key = entry;
+	while (key > 0 && !index[key].key)
+		key--;
+	// decode forward from where we are when that is on the way
+	long first = position >= key && position < entry ? position + 1 : key;
+	for (long i = first; i <= entry; i++) {
+		if (!decode(size_t(i))) {
+			position = -1;
+			return false;
+		}
+		position = i;
+	}
+	return true;
+}
+
+bool FlightPlayback::decode(size_t entry) {
+	size_t offset = size_t(index[entry].offset);
+	FlightChunk chunk;
+	if (offset + sizeof(chunk) > size)
+		return false;
+	memcpy(&chunk, data + offset, sizeof(chunk));
+	if (chunk.magic != FLIGHT_CHUNK_MAGIC || offset + sizeof(chunk) + chunk.bytes > size)
+		return false;
+
+	const unsigned char *p = data + offset + sizeof(chunk), *end = p + chunk.bytes;
+	for (Channel &channel : channels) {
+		uint64_t count;
+		if (!get_varint(p, end, count) || count > uint64_t(end - p))
+			return false;
+		size_t deltas = chunk.key ? 0 : std::min(size_t(count), channel.quantized.size());
+		channel.quantized.resize(size_t(count));
+		channel.values.resize(size_t(count));
+		for (size_t i = 0; i < count; i++) {
+			uint64_t value;
+			if (!get_varint(p, end, value))
+				return false;
+			int32_t q = int32_t(unzigzag(value) + (i < deltas ? channel.quantized[i] : 0));
+			channel.quantized[i] = q;
+			channel.values[i] = float(q) * channel.info.quantum;
+		}
+	}
+	current_time = chunk.time;
+	return true;
+}
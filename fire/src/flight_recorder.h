@@ -0,0 +1,190 @@
+// Simulation flight recorder
+//
+// Records the simulation state of every frame (particles, joint angles, camera, ...)
+// as named channels of floats into an append-only file, so a run can be replayed
+// and rendered without simulating. Each value is quantized to its channel's
+// quantum and stored as the zigzag varint of its difference from the same element
+// of the previous frame; every KEY_INTERVAL frames a key frame stores the values
+// themselves, so playback can start there. Frames are encoded on the render thread
+// into large blocks that a writer thread appends to the file.
+//
+// File layout (little-endian):
+//   FlightHeader, then FlightChannel[channels]
+//   per frame: FlightChunk, then per channel a varint count and count varints
+//   on close(): FlightIndexEntry[frames], then FlightTrailer
+// A recording that was not closed has no index; playback rebuilds it by walking
+// the chunks, so a crash loses at most the block that was not written yet.
+//
+// Playback maps the file and seeks to any frame by decoding forward from the key
+// frame before it. Not available on Windows, where open() fails.
+//
+// Deltas are only small while an element holds the same object from frame to
+// frame. The particle pools swap-remove, so each death moves one particle to a new
+// position, and its values there cost a full delta for one frame. Since almost
+// every value already takes the one byte minimum, this is cheaper than giving each
+// particle a slot for life (see bench_flight_recorder).
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint32_t FLIGHT_VERSION = 1;
+const int FLIGHT_NAME_LENGTH = 32;           // including the terminator
+
+struct FlightHeader {
+	char magic[8];                           // "BAFLIGHT"
+	uint32_t version;
+	uint32_t channels;
+};
+
+struct FlightChannel {
+	char name[FLIGHT_NAME_LENGTH];
+	float quantum;                           // values are stored as multiples of it
+};
+
+struct FlightChunk {
+	uint32_t magic;                          // FLIGHT_CHUNK_MAGIC
+	uint32_t bytes;                          // of the channel data that follows
+	int64_t frame;
+	double time;                             // seconds, see FrameTime()
+	uint32_t key;                            // 1 when the values are not deltas
+	uint32_t reserved;
+};
+
+const uint32_t FLIGHT_CHUNK_MAGIC = 0x4b434846;   // "FHCK"
+
+struct FlightIndexEntry {
+	int64_t frame;
+	uint64_t offset;                         // of the FlightChunk
+	uint32_t key;
+	uint32_t reserved;
+};
+
+struct FlightTrailer {
+	uint64_t index_offset;
+	uint64_t entries;
+	char magic[8];                           // "BAFLIDX"
+};
+
+struct FlightRecorderStats {
+	long frames;
+	long key_frames;
+	uint64_t bytes;                          // written to the file so far
+	uint64_t raw_bytes;                      // the same frames as plain floats
+	double encode_ms;                        // total time in end_frame()
+};
+
+class FlightRecorder {
+public:
+	static const int KEY_INTERVAL = 60;
+	static const size_t BLOCK_BYTES = 256 * 1024;   // handed to the writer when full
+
+	FlightRecorder();
+	~FlightRecorder();
+
+	// Channels are declared before open(); returns the channel's id
+	int add_channel(const char *name, float quantum);
+
+	// Creates the file and the writer thread; false when it cannot be created
+	bool open(const char *path);
+	// Writes what is left and the index
+	void close();
+	bool active() const { return file != NULL; }
+
+	// Render thread: record() each channel between begin_frame() and end_frame();
+	// a channel that is not recorded in a frame stores no values
+	void begin_frame(long frame, double time);
+	void record(int channel, const float *values, size_t count);
+	void end_frame();
+
+	const FlightRecorderStats &stats() const { return current; }
+
+private:
+	struct Channel {
+		FlightChannel info;
+		std::vector<float> values;           // this frame
+		std::vector<int32_t> previous;       // quantized, the last frame
+	};
+
+	std::vector<Channel> channels;
+	FILE *file;
+	FlightRecorderStats current;
+	long frame;
+	double time;
+	long since_key;
+	std::vector<FlightIndexEntry> index;
+	std::vector<unsigned char> block;       // being filled on the render thread
+
+	std::mutex mutex;
+	std::condition_variable block_ready;
+	std::deque<std::vector<unsigned char> > full_blocks;
+	std::vector<std::vector<unsigned char> > spare_blocks;
+	bool stopping;
+	std::thread writer;
+
+	void hand_off_block();
+	void write_loop();
+
+	FlightRecorder(const FlightRecorder &);
+	FlightRecorder &operator=(const FlightRecorder &);
+};
+
+class FlightPlayback {
+public:
+	FlightPlayback();
+	~FlightPlayback();
+
+	// Maps a recording; false when it is missing or not a recording
+	bool open(const char *path);
+	void close();
+	bool active() const { return data != NULL; }
+
+	size_t frames() const { return index.size(); }
+	long first_frame() const { return index.empty() ? 0 : long(index.front().frame); }
+	long last_frame() const { return index.empty() ? 0 : long(index.back().frame); }
+	int num_channels() const { return int(channels.size()); }
+	const FlightChannel &channel_info(int channel) const { return channels[channel].info; }
+	// -1 when the recording has no such channel
+	int channel(const char *name) const;
+
+	// Decodes a recorded frame (the last one before it when it was not recorded);
+	// false when the file is damaged there
+	bool seek(long frame);
+	long frame() const { return position < 0 ? -1 : long(index[position].frame); }
+	double time() const { return current_time; }
+	const std::vector<float> &values(int channel) const { return channels[channel].values; }
+
+private:
+	struct Channel {
+		FlightChannel info;
+		std::vector<int32_t> quantized;
+		std::vector<float> values;
+	};
+
+	const unsigned char *data;
+	size_t size;
+	std::vector<Channel> channels;
+	std::vector<FlightIndexEntry> index;
+	long position;                           // into index, -1 before the first seek
+	double current_time;
+
+	bool read_index();
+	void rebuild_index(size_t start);
+	bool decode(size_t entry);
+
+	FlightPlayback(const FlightPlayback &);
+	FlightPlayback &operator=(const FlightPlayback &);
+};
+
+extern FlightRecorder flight_recorder;
+extern FlightPlayback flight_playback;
+
+#endif // FLIGHT_RECORDER_H
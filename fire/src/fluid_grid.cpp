@@ -0,0 +1,220 @@
+// Eulerian heat/velocity grid for the fire plume
+
+#include "fluid_grid.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <cmath>
+
+FluidGrid::FluidGrid(const glm::vec3 &lo, const glm::vec3 &hi, const FluidSettings &settings)
+	: box_min(lo), box_max(hi), cell(1.0f), nx(0), ny(0), nz(0), stride_z(0), stride_y(0), settings(settings) {
+	configure(settings);
+}
+
+void FluidGrid::configure(const FluidSettings &new_settings) {
+	bool resize = nx == 0 || new_settings.resolution != settings.resolution;
+	settings = new_settings;
+	if (!resize)
+		return;
+
+	glm::vec3 extent = box_max - box_min;
+	cell = std::max(extent.x, std::max(extent.y, extent.z)) / std::max(settings.resolution, 2);
+	nx = std::max(2, int(std::ceil(extent.x / cell - 0.01f)));
+	ny = std::max(2, int(std::ceil(extent.y / cell - 0.01f)));
+	nz = std::max(2, int(std::ceil(extent.z / cell - 0.01f)));
+	stride_z = nx + 2;
+	stride_y = (nx + 2) * (nz + 2);
+
+	size_t size = size_t(stride_y) * (ny + 2);
+	std::vector<float> *fields[] = { &u, &v, &w, &heat, &u_prev, &v_prev, &w_prev, &heat_prev, &pressure, &pressure_next, &divergence };
+	for (std::vector<float> *field : fields)
+		field->assign(size, 0.0f);
+}
+
+void FluidGrid::clear() {
+	std::vector<float> *fields[] = { &u, &v, &w, &heat, &u_prev, &v_prev, &w_prev, &heat_prev, &pressure, &pressure_next, &divergence };
+	for (std::vector<float> *field : fields)
+		std::fill(field->begin(), field->end(), 0.0f);
+}
+
+void FluidGrid::add_heat(const glm::vec3 &at, float amount) {
+	glm::vec3 g = (at - box_min) / cell;
+	int x = int(std::floor(g.x)), y = int(std::floor(g.y)), z = int(std::floor(g.z));
+	if (x < 0 || y < 0 || z < 0 || x >= nx || y >= ny || z >= nz)
+		return;
+	source_cells.push_back(index(x, y, z));
+	source_amounts.push_back(amount);
+}
+
+//----------------------------------------------------------------------------
+
+// g is in cell-centre units: cell (x, y, z) is at g = (x, y, z)
+float FluidGrid::sample(const std::vector<float> &field, glm::vec3 g) const {
+	g = glm::clamp(g, glm::vec3(0.0f), glm::vec3(nx - 1, ny - 1, nz - 1));
+	int x = std::min(int(g.x), nx - 2), y = std::min(int(g.y), ny - 2), z = std::min(int(g.z), nz - 2);
+	float fx = g.x - x, fy = g.y - y, fz = g.z - z;
+	const float *c = &field[index(x, y, z)];
+	float c00 = c[0] + (c[1] - c[0]) * fx;
+	float c01 = c[stride_z] + (c[stride_z + 1] - c[stride_z]) * fx;
+	float c10 = c[stride_y] + (c[stride_y + 1] - c[stride_y]) * fx;
+	float c11 = c[stride_y + stride_z] + (c[stride_y + stride_z + 1] - c[stride_y + stride_z]) * fx;
+	float c0 = c00 + (c01 - c00) * fz;
+	float c1 = c10 + (c11 - c10) * fz;
+	return c0 + (c1 - c0) * fy;
+}
+
+glm::vec3 FluidGrid::velocity_at(const glm::vec3 &at) const {
+	glm::vec3 g = (at - box_min) / cell - glm::vec3(0.5f);
+	return glm::vec3(sample(u, g), sample(v, g), sample(w, g));
+}
+
+// Closed walls and floor (normal velocity mirrored), open top (velocity copied)
+void FluidGrid::set_velocity_border() {
+	for (int y = 0; y < ny; y++)
+		for (int z = 0; z < nz; z++) {
+			int lo = index(0, y, z), hi = index(nx - 1, y, z);
+			u[lo - 1] = -u[lo]; v[lo - 1] = v[lo]; w[lo - 1] = w[lo];
+			u[hi + 1] = -u[hi]; v[hi + 1] = v[hi]; w[hi + 1] = w[hi];
+		}
+	for (int y = 0; y < ny; y++)
+		for (int x = 0; x < nx; x++) {
+			int lo = index(x, y, 0), hi = index(x, y, nz - 1);
+			u[lo - stride_z] = u[lo]; v[lo - stride_z] = v[lo]; w[lo - stride_z] = -w[lo];
+			u[hi + stride_z] = u[hi]; v[hi + stride_z] = v[hi]; w[hi + stride_z] = -w[hi];
+		}
+	for (int z = 0; z < nz; z++)
+		for (int x = 0; x < nx; x++) {
+			int lo = index(x, 0, z), hi = index(x, ny - 1, z);
+			u[lo - stride_y] = u[lo]; v[lo - stride_y] = -v[lo]; w[lo - stride_y] = w[lo];
+			u[hi + stride_y] = u[hi]; v[hi + stride_y] = v[hi]; w[hi + stride_y] = w[hi];
+		}
+}
+
+// Zero gradient at the walls and floor, zero pressure above the open top
+void FluidGrid::set_pressure_border(std::vector<float> &p) {
+	for (int y = 0; y < ny; y++)
+		for (int z = 0; z < nz; z++) {
+			int lo = index(0, y, z), hi = index(nx - 1, y, z);
+			p[lo - 1] = p[lo];
+			p[hi + 1] = p[hi];
+		}
+	for (int y = 0; y < ny; y++)
+		for (int x = 0; x < nx; x++) {
+			int lo = index(x, y, 0), hi = index(x, y, nz - 1);
+			p[lo - stride_z] = p[lo];
+			p[hi + stride_z] = p[hi];
+		}
+	for (int z = 0; z < nz; z++)
+		for (int x = 0; x < nx; x++) {
+			int lo = index(x, 0, z), hi = index(x, ny - 1, z);
+			p[lo - stride_y] = p[lo];
+			p[hi + stride_y] = 0.0f;
+		}
+}
+
+//----------------------------------------------------------------------------
+
+void FluidGrid::add_forces(float dt) {
+	for (size_t i = 0; i < source_cells.size(); i++)
+		heat[source_cells[i]] += source_amounts[i] * dt;
+
+	float lift = settings.buoyancy * dt;
+	float keep_velocity = std::max(0.0f, 1.0f - settings.velocity_damping * dt);
+	float keep_heat = std::max(0.0f, 1.0f - settings.heat_decay * dt);
+	job_system().parallel_for(ny, 1, [&](int begin, int end) {
+		for (int y = begin; y < end; y++)
+			for (int z = 0; z < nz; z++) {
+				int row = index(0, y, z);
+				float *ur = &u[row], *vr = &v[row], *wr = &w[row], *hr = &heat[row];
+				for (int x = 0; x < nx; x++) {
+					ur[x] *= keep_velocity;
+					vr[x] = (vr[x] + lift * hr[x]) * keep_velocity;
+					wr[x] *= keep_velocity;
+					hr[x] *= keep_heat;
+				}
+			}
+	});
+}
+
+void FluidGrid::advect(float dt) {
+	u.swap(u_prev);
+	v.swap(v_prev);
+	w.swap(w_prev);
+	heat.swap(heat_prev);
+
+	float steps = dt / cell;
+	job_system().parallel_for(ny, 1, [&](int begin, int end) {
+		for (int y = begin; y < end; y++)
+			for (int z = 0; z < nz; z++)
+				for (int x = 0; x < nx; x++) {
+					int i = index(x, y, z);
+					glm::vec3 back = glm::vec3(x, y, z) - steps * glm::vec3(u_prev[i], v_prev[i], w_prev[i]);
+					u[i] = sample(u_prev, back);
+					v[i] = sample(v_prev, back);
+					w[i] = sample(w_prev, back);
+					heat[i] = sample(heat_prev, back);
+				}
+	});
+}
+
+void FluidGrid::project() {
+	float half_cell = 0.5f * cell;
+	job_system().parallel_for(ny, 1, [&](int begin, int end) {
+		for (int y = begin; y < end; y++)
+			for (int z = 0; z < nz; z++) {
+				int row = index(0, y, z);
+				const float *ur = &u[row], *vr = &v[row], *wr = &w[row];
+				float *d = &divergence[row];
+				for (int x = 0; x < nx; x++)
+					d[x] = -half_cell * (ur[x + 1] - ur[x - 1] + vr[x + stride_y] - vr[x - stride_y] + wr[x + stride_z] - wr[x - stride_z]);
+			}
+	});
+
+	// Jacobi iterations; each one reads only the previous iterate, so slabs are independent
+	std::fill(pressure.begin(), pressure.end(), 0.0f);
+	for (int k = 0; k < settings.pressure_iterations; k++) {
+		const int sy = stride_y, sz = stride_z;
+		job_system().parallel_for(ny, 1, [&](int begin, int end) {
+			for (int y = begin; y < end; y++)
+				for (int z = 0; z < nz; z++) {
+					int row = index(0, y, z);
+					const float *p = &pressure[row], *d = &divergence[row];
+					float *out = &pressure_next[row];
+					for (int x = 0; x < nx; x++)
+						out[x] = (d[x] + p[x - 1] + p[x + 1] + p[x - sz] + p[x + sz] + p[x - sy] + p[x + sy]) * (1.0f / 6.0f);
+				}
+		});
+		pressure.swap(pressure_next);
+		set_pressure_border(pressure);
+	}
+
+	float scale = 0.5f / cell;
+	job_system().parallel_for(ny, 1, [&](int begin, int end) {
+		for (int y = begin; y < end; y++)
+			for (int z = 0; z < nz; z++) {
+				int row = index(0, y, z);
+				const float *p = &pressure[row];
+				float *ur = &u[row], *vr = &v[row], *wr = &w[row];
+				for (int x = 0; x < nx; x++) {
+					ur[x] -= scale * (p[x + 1] - p[x - 1]);
+					vr[x] -= scale * (p[x + stride_y] - p[x - stride_y]);
+					wr[x] -= scale * (p[x + stride_z] - p[x - stride_z]);
+				}
+			}
+	});
+}
+
+void FluidGrid::step(float dt) {
+	int substeps = std::min(4, std::max(1, int(std::ceil(dt / settings.max_dt))));
+	float h = std::min(dt / substeps, settings.max_dt);   // a long stall is not fully caught up
+	for (int i = 0; i < substeps; i++) {
+		add_forces(h);
+		set_velocity_border();
+		advect(h);
+		set_velocity_border();
+		project();
+		set_velocity_border();
+	}
+	source_cells.clear();
+	source_amounts.clear();
+}
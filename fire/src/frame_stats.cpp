@@ -0,0 +1,263 @@
+// Frame-time statistics
+
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+FrameStats frame_stats;
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//----------------------------------------------------------------------------
+
+void FrameHistogram::clear() {
+	memset(counts, 0, sizeof(counts));
+	samples = max_us = 0;
+}
+
+int FrameHistogram::bucket(unsigned us) {
+	if (us < 2 * SUB_BUCKETS)
+		return int(us);
+	int shift = 0;
+	while ((us >> shift) >= 2 * SUB_BUCKETS)
+		shift++;
+	int b = shift * SUB_BUCKETS + int(us >> shift);
+	return b < BUCKETS ? b : BUCKETS - 1;
+}
+
+unsigned FrameHistogram::bucket_upper(int b) {
+	if (b < 2 * SUB_BUCKETS)
+		return unsigned(b);
+	int shift = b / SUB_BUCKETS - 1;
+	unsigned sub = unsigned(b - shift * SUB_BUCKETS);
+	return ((sub + 1) << shift) - 1;
+}
+
+void FrameHistogram::add(float ms) {
+	unsigned us = ms > 0.0f ? unsigned(std::min(ms * 1000.0f, 4.0e9f)) : 0;
+	counts[bucket(us)]++;
+	samples++;
+	if (us > max_us)
+		max_us = us;
+}
+
+void FrameHistogram::add(const FrameHistogram &other) {
+	for (int b = 0; b < BUCKETS; b++)
+		counts[b] += other.counts[b];
+	samples += other.samples;
+	if (other.max_us > max_us)
+		max_us = other.max_us;
+}
+
+float FrameHistogram::percentile(double fraction) const {
+	if (samples == 0)
+		return 0.0f;
+	unsigned target = unsigned(std::ceil(fraction * samples));
+	if (target == 0)
+		target = 1;
+	unsigned seen = 0;
+	for (int b = 0; b < BUCKETS; b++) {
+		seen += counts[b];
+		if (seen >= target)
+			return std::min(bucket_upper(b), max_us) * 0.001f;
+	}
+	return max_ms();
+}
+
+//----------------------------------------------------------------------------
+
+FrameStats::FrameStats() : head(0), tail(0), dropped(0), slice(0), frames(0), published_sequence(0), running(false) {
+	for (int m = 0; m < FRAME_METRICS; m++)
+		pending.ms[m] = 0.0f;
+	pending.ms[FRAME_GPU] = -1.0f;
+	last = pending;
+	memset(&published, 0, sizeof(published));
+}
+
+FrameStats::~FrameStats() {
+	stop();
+}
+
+const char *FrameStats::metric_name(int metric) {
+	static const char *names[FRAME_METRICS] = { "sim", "submit", "gpu", "total" };
+	return names[metric];
+}
+
+void FrameStats::start(double export_seconds) {
+	if (running)
+		return;
+	const char *name = getenv("FRAME_STATS");
+	prefix = name != NULL && *name != '\0' ? name : "frame_stats";
+	running = true;
+	collector = std::thread(&FrameStats::collect, this, export_seconds);
+}
+
+void FrameStats::stop() {
+	if (!running)
+		return;
+	running = false;
+	collector.join();
+}
+
+void FrameStats::end_frame(double gpu_ms, double total_ms) {
+	pending.ms[FRAME_GPU] = float(gpu_ms);
+	pending.ms[FRAME_TOTAL] = float(total_ms);
+
+	unsigned h = head.load(std::memory_order_relaxed);
+	if (h - tail.load(std::memory_order_acquire) < unsigned(RING_SIZE)) {
+		ring[h & (RING_SIZE - 1)] = pending;
+		head.store(h + 1, std::memory_order_release);
+	} else {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	last = pending;
+	pending.ms[FRAME_SIM] = pending.ms[FRAME_SUBMIT] = 0.0f;
+}
+
+FrameStatsSummary FrameStats::summary() const {
+	FrameStatsSummary copy;
+	for (;;) {
+		unsigned before = published_sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+		memcpy(&copy, &published, sizeof(copy));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (published_sequence.load(std::memory_order_relaxed) == before)
+			return copy;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Collector thread
+
+void FrameStats::drain() {
+	unsigned t = tail.load(std::memory_order_relaxed);
+	unsigned h = head.load(std::memory_order_acquire);
+	for (; t != h; t++) {
+		const FrameSample &sample = ring[t & (RING_SIZE - 1)];
+		for (int m = 0; m < FRAME_METRICS; m++) {
+			if (sample.ms[m] < 0.0f)
+				continue;
+			slices[slice][m].add(sample.ms[m]);
+			run[m].add(sample.ms[m]);
+		}
+		frames++;
+	}
+	tail.store(t, std::memory_order_release);
+}
+
+static FrameMetricSummary summarize_histogram(const FrameHistogram &histogram) {
+	FrameMetricSummary summary;
+	summary.p50 = histogram.percentile(0.50);
+	summary.p95 = histogram.percentile(0.95);
+	summary.p99 = histogram.percentile(0.99);
+	summary.max = histogram.max_ms();
+	summary.frames = histogram.count();
+	return summary;
+}
+
+FrameStatsSummary FrameStats::summarize(double seconds) const {
+	FrameStatsSummary summary;
+	summary.seconds = seconds;
+	summary.frames = frames;
+	summary.dropped = dropped.load(std::memory_order_relaxed);
+	for (int m = 0; m < FRAME_METRICS; m++) {
+		FrameHistogram window;
+		for (int s = 0; s < WINDOW_SECONDS; s++)
+			window.add(slices[s][m]);
+		summary.window[m] = summarize_histogram(window);
+		summary.run[m] = summarize_histogram(run[m]);
+	}
+	return summary;
+}
+
+void FrameStats::publish(const FrameStatsSummary &summary) {
+	unsigned sequence = published_sequence.load(std::memory_order_relaxed);
+	published_sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&published, &summary, sizeof(summary));
+	published_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static void write_json_metrics(FILE *fp, const FrameMetricSummary *metrics) {
+	for (int m = 0; m < FRAME_METRICS; m++) {
+		const FrameMetricSummary &s = metrics[m];
+		fprintf(fp, "    \"%s\": {\"frames\": %u, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+		        FrameStats::metric_name(m), s.frames, s.p50, s.p95, s.p99, s.max, m + 1 < FRAME_METRICS ? "," : "");
+	}
+}
+
+void FrameStats::write_exports(const FrameStatsSummary &summary, bool truncate) {
+	// a failed write only loses this export; the histograms carry on
+	FILE *fp = fopen((prefix + ".csv").c_str(), truncate ? "w" : "a");
+	if (fp != NULL) {
+		if (truncate)
+			fprintf(fp, "seconds,metric,frames,p50_ms,p95_ms,p99_ms,max_ms\n");
+		for (int m = 0; m < FRAME_METRICS; m++) {
+			const FrameMetricSummary &s = summary.window[m];
+			fprintf(fp, "%.1f,%s,%u,%.3f,%.3f,%.3f,%.3f\n", summary.seconds, metric_name(m), s.frames,
+			        s.p50, s.p95, s.p99, s.max);
+		}
+		fclose(fp);
+	}
+
+	fp = fopen((prefix + ".json").c_str(), "w");
+	if (fp != NULL) {
+		fprintf(fp, "{\n  \"seconds\": %.1f,\n  \"frames\": %u,\n  \"dropped\": %u,\n  \"window_seconds\": %d,\n",
+		        summary.seconds, summary.frames, summary.dropped, WINDOW_SECONDS);
+		fprintf(fp, "  \"window\": {\n");
+		write_json_metrics(fp, summary.window);
+		fprintf(fp, "  },\n  \"run\": {\n");
+		write_json_metrics(fp, summary.run);
+		fprintf(fp, "  }\n}\n");
+		fclose(fp);
+	}
+}
+
+void FrameStats::collect(double export_seconds) {
+	for (int s = 0; s < WINDOW_SECONDS; s++)
+		for (int m = 0; m < FRAME_METRICS; m++)
+			slices[s][m].clear();
+	for (int m = 0; m < FRAME_METRICS; m++)
+		run[m].clear();
+	slice = 0;
+	frames = 0;
+
+	Clock::time_point start = Clock::now();
+	double slice_end = 1.0, next_export = export_seconds;
+	bool exported = false;
+	while (running.load(std::memory_order_relaxed)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		drain();
+		double seconds = seconds_since(start);
+		if (seconds >= slice_end) {
+			// the oldest second leaves the window
+			slice = (slice + 1) % WINDOW_SECONDS;
+			for (int m = 0; m < FRAME_METRICS; m++)
+				slices[slice][m].clear();
+			slice_end = std::floor(seconds) + 1.0;
+		}
+		FrameStatsSummary summary = summarize(seconds);
+		publish(summary);
+		if (seconds >= next_export) {
+			write_exports(summary, !exported);
+			exported = true;
+			next_export = seconds + export_seconds;
+		}
+	}
+
+	drain();
+	FrameStatsSummary summary = summarize(seconds_since(start));
+	publish(summary);
+	write_exports(summary, !exported);
+}
@@ -0,0 +1,123 @@
+// Frame-time statistics
+//
+// Once per frame the render thread hands over the CPU simulation, CPU submission,
+// GPU and total (swap to swap) times. Recording is a copy into a single-producer
+// ring, so it never blocks or allocates; a collector thread drains the ring into
+// log-linear (HDR-style) histograms with ~3% resolution from 1 us to 30 s, keeps
+// them per second, and reports p50/p95/p99/max over the last few seconds and over
+// the whole run. Every few seconds, and on stop(), it appends the rolling window to
+// <prefix>.csv and rewrites <prefix>.json with both summaries. The prefix is
+// frame_stats unless the FRAME_STATS environment variable names another.
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+enum FrameMetric { FRAME_SIM, FRAME_SUBMIT, FRAME_GPU, FRAME_TOTAL, FRAME_METRICS };
+
+// Times of one frame in milliseconds; negative when not measured
+struct FrameSample {
+	float ms[FRAME_METRICS];
+};
+
+// Log-linear histogram of microsecond values: exact below 64 us, then 32 buckets per
+// power of two
+class FrameHistogram {
+public:
+	static const int SUB_BUCKETS = 32;
+	static const int BUCKETS = 21 * SUB_BUCKETS;
+
+	FrameHistogram() { clear(); }
+
+	void clear();
+	void add(float ms);
+	void add(const FrameHistogram &other);
+
+	// Upper edge of the bucket holding the given fraction of the samples, in ms
+	float percentile(double fraction) const;
+	float max_ms() const { return max_us * 0.001f; }
+	unsigned count() const { return samples; }
+
+	static int bucket(unsigned us);
+	static unsigned bucket_upper(int bucket);    // largest us value in the bucket
+
+private:
+	unsigned counts[BUCKETS];
+	unsigned samples, max_us;
+};
+
+struct FrameMetricSummary {
+	float p50, p95, p99, max;      // ms
+	unsigned frames;
+};
+
+struct FrameStatsSummary {
+	double seconds;                // since start()
+	unsigned frames, dropped;      // dropped: the ring was full
+	FrameMetricSummary window[FRAME_METRICS];    // the last WINDOW_SECONDS
+	FrameMetricSummary run[FRAME_METRICS];       // since start()
+};
+
+class FrameStats {
+public:
+	static const int WINDOW_SECONDS = 10;
+	static const int RING_SIZE = 1024;           // frames; a power of two
+
+	FrameStats();
+	~FrameStats();
+
+	// Starts the collector thread; exports every export_seconds
+	void start(double export_seconds = 5.0);
+	// Drains what is left, writes the final export and joins the thread
+	void stop();
+
+	// Render thread only. The times accumulate until end_frame() records the frame.
+	void add_sim_ms(double ms) { pending.ms[FRAME_SIM] += float(ms); }
+	void add_submit_ms(double ms) { pending.ms[FRAME_SUBMIT] += float(ms); }
+	void end_frame(double gpu_ms, double total_ms);
+	const FrameSample &last_frame() const { return last; }
+
+	// Latest summary published by the collector (about ten times a second); safe from
+	// any thread
+	FrameStatsSummary summary() const;
+
+	static const char *metric_name(int metric);
+
+private:
+	FrameSample pending, last;
+
+	// single producer (end_frame), single consumer (the collector)
+	FrameSample ring[RING_SIZE];
+	std::atomic<unsigned> head, tail;
+	std::atomic<unsigned> dropped;
+
+	// collector thread only
+	FrameHistogram slices[WINDOW_SECONDS][FRAME_METRICS];    // one per second
+	FrameHistogram run[FRAME_METRICS];
+	int slice;
+	unsigned frames;
+	std::string prefix;
+
+	// seqlock around the published summary: odd while it is being written
+	mutable std::atomic<unsigned> published_sequence;
+	FrameStatsSummary published;
+
+	std::thread collector;
+	std::atomic<bool> running;
+
+	void collect(double export_seconds);
+	void drain();
+	FrameStatsSummary summarize(double seconds) const;
+	void publish(const FrameStatsSummary &summary);
+	void write_exports(const FrameStatsSummary &summary, bool truncate);
+
+	FrameStats(const FrameStats &);
+	FrameStats &operator=(const FrameStats &);
+};
+
+extern FrameStats frame_stats;
+
+#endif // FRAME_STATS_H
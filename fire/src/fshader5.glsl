@@ -1,8 +1,8 @@
 #version 150
 
 in vec2 uv_pos;
+flat in vec4 draw_color;
 flat in int use_texture;
-uniform vec4 SetColor;
 
 out vec4 color;
 
@@ -29,11 +29,11 @@ void main()
 		i = int(mod(scale*u, size));
 	    j = int(mod(scale*v, size));
 
-	    color = pattern[i][j]*SetColor;
-	    color.a = SetColor.a;
+	    color = pattern[i][j]*draw_color;
+	    color.a = draw_color.a;
     }
     else{
-    	color = SetColor;
+    	color = draw_color;
     }
     
 }
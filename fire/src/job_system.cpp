@@ -0,0 +1,86 @@
+// A small persistent worker pool for data-parallel passes
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+
+JobSystem::JobSystem(int num_workers)
+	: task(NULL), task_size(0), task_grain(1), next_index(0), active_workers(0), generation(0), stopping(false), busy_ns(0) {
+	if (num_workers <= 0)
+		num_workers = std::max(0, int(std::thread::hardware_concurrency()) - 1);
+	for (int i = 0; i < num_workers; i++)
+		workers.push_back(std::thread(&JobSystem::worker_loop, this));
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+void JobSystem::run_ranges() {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (;;) {
+		int begin = next_index.fetch_add(task_grain);
+		if (begin >= task_size)
+			break;
+		(*task)(begin, std::min(begin + task_grain, task_size));
+	}
+	busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void JobSystem::worker_loop() {
+	unsigned long seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+		}
+		run_ranges();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--active_workers == 0)
+				finished.notify_one();
+		}
+	}
+}
+
+void JobSystem::parallel_for(int n, int grain, const std::function<void(int, int)> &fn) {
+	if (n <= 0)
+		return;
+	if (workers.empty() || n <= grain) {
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		fn(0, n);
+		busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &fn;
+		task_size = n;
+		task_grain = std::max(1, grain);
+		next_index = 0;
+		active_workers = int(workers.size());
+		generation++;
+	}
+	wake.notify_all();
+	run_ranges();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&]() { return active_workers == 0; });
+	task = NULL;
+}
+
+JobSystem &job_system() {
+	static JobSystem *pool = new JobSystem();    // never deleted; lives until exit
+	return *pool;
+}
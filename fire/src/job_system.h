@@ -0,0 +1,52 @@
+// A small persistent worker pool for data-parallel passes
+//
+// parallel_for(n, fn) calls fn(begin, end) over disjoint ranges of [0, n) on the
+// workers and the calling thread, and returns when all of them are done. Busy time
+// is accumulated so callers can report utilization.
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	const std::function<void(int, int)> *task;
+	int task_size, task_grain;
+	std::atomic<int> next_index;
+	int active_workers;
+	unsigned long generation;
+	bool stopping;
+	std::atomic<long long> busy_ns;
+
+	void worker_loop();
+	void run_ranges();
+
+	JobSystem(const JobSystem &);
+	JobSystem &operator=(const JobSystem &);
+
+public:
+	// num_workers <= 0 picks one less than the number of hardware threads
+	explicit JobSystem(int num_workers = 0);
+	~JobSystem();
+
+	int num_threads() const { return int(workers.size()) + 1; }
+
+	// grain is the number of indices handed out at a time
+	void parallel_for(int n, int grain, const std::function<void(int, int)> &fn);
+
+	// Nanoseconds spent inside parallel_for tasks, summed over all threads
+	long long busy_time_ns() const { return busy_ns.load(); }
+};
+
+// Shared pool used by the simulations
+extern JobSystem &job_system();
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,91 @@
+// Bounded multi-producer/multi-consumer lock-free queue (Dmitry Vyukov's design)
+//
+// Each cell carries a sequence number that tells producers and consumers whether
+// it is free to write or ready to read, so push and pop are a single CAS on the
+// shared position in the uncontended case and never block.
+
+#ifndef LOCKFREE_QUEUE_H
+#define LOCKFREE_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T>
+class MpmcQueue {
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	// producers and consumers each get their own cache line
+	Cell *cells;
+	size_t mask;
+	char pad0[64];
+	std::atomic<size_t> enqueue_pos;
+	char pad1[64];
+	std::atomic<size_t> dequeue_pos;
+	char pad2[64];
+
+	MpmcQueue(const MpmcQueue &);
+	MpmcQueue &operator=(const MpmcQueue &);
+
+public:
+	// capacity is rounded up to a power of two
+	explicit MpmcQueue(size_t capacity) : enqueue_pos(0), dequeue_pos(0) {
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		cells = new Cell[size];
+		mask = size - 1;
+		for (size_t i = 0; i < size; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~MpmcQueue() {
+		delete [] cells;
+	}
+
+	// false when full
+	bool push(const T &value) {
+		size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = cells[pos & mask];
+			size_t seq = cell.sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos);
+			if (diff == 0) {
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.data = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	// false when empty
+	bool pop(T &value) {
+		size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = cells[pos & mask];
+			size_t seq = cell.sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos + 1);
+			if (diff == 0) {
+				if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					value = cell.data;
+					cell.sequence.store(pos + mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = dequeue_pos.load(std::memory_order_relaxed);
+		}
+	}
+};
+
+#endif // LOCKFREE_QUEUE_H
@@ -2,12 +2,36 @@
 // Modified to isolate the main program and use GLM
 
  #include "common.h"
+#include "startup_trace.h"
+#include "frame_stats.h"
+#include "hud.h"
+#include "telemetry.h"
+#include "frame_capture.h"
+#include "flight_recorder.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef EMBED_SHADERS
+// make generates shaders_embedded.h from the .glsl files (see the Makefile)
+struct EmbeddedShader {
+   const char*  name;
+   const char*  source;
+};
+#  include "shaders_embedded.h"
+#endif
 
 // Create a NULL-terminated string by reading the provided file
 static char*
-readShaderSource(const char* shaderFile)
+readShaderFile(const char* shaderFile)
 {
    FILE* fp = fopen(shaderFile, "rb");
 
@@ -26,11 +50,151 @@ readShaderSource(const char* shaderFile)
    return buf;
 }
 
+// The embedded copy of a shader when the build has one, else the file
+static char*
+readShaderSource(const char* shaderFile)
+{
+#ifdef EMBED_SHADERS
+   const char* name = strrchr( shaderFile, '/' ) ? strrchr( shaderFile, '/' ) + 1 : shaderFile;
+   for ( const EmbeddedShader& embedded : embedded_shaders ) {
+      if ( strcmp( embedded.name, name ) == 0 ) {
+         char* buf = new char[strlen( embedded.source ) + 1];
+         strcpy( buf, embedded.source );
+         return buf;
+      }
+   }
+#endif
+   return readShaderFile( shaderFile );
+}
+
 
-// Create a GLSL program object from vertex and fragment shader files
+//----------------------------------------------------------------------------
+// Program binary cache: a linked program is saved as shader-<hash>.bin in the
+// working directory, keyed on both sources and the driver strings, and loaded
+// instead of compiling on later launches. Drivers without program binaries, or
+// that reject a saved one (e.g. after an update), simply compile. Mesa only offers
+// a binary format while its own shader cache is enabled. With llvmpipe both demos'
+// programs load in about 1.5 ms instead of 10-20 ms of compiling.
+
+static const char programCacheMagic[4] = { 'G', 'L', 'P', 'B' };
+
+static bool
+programBinarySupported()
+{
+   if ( !GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary ) { return false; }
+
+   GLint formats = 0;
+   glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+   return formats > 0;
+}
+
+// 64-bit FNV-1a, with a terminator so ("ab", "c") and ("a", "bc") differ
+static unsigned long long
+hashString(unsigned long long hash, const char* s)
+{
+   for ( ; s != NULL && *s != '\0'; ++s ) {
+      hash ^= (unsigned char)*s;
+      hash *= 1099511628211ULL;
+   }
+   hash ^= 0xff;
+   hash *= 1099511628211ULL;
+   return hash;
+}
+
+static std::string
+programCachePath(const char* vSource, const char* fSource)
+{
+   unsigned long long hash = 14695981039346656037ULL;
+   hash = hashString( hash, vSource );
+   hash = hashString( hash, fSource );
+   hash = hashString( hash, (const char*) glGetString( GL_VENDOR ) );
+   hash = hashString( hash, (const char*) glGetString( GL_RENDERER ) );
+   hash = hashString( hash, (const char*) glGetString( GL_VERSION ) );
+
+   char name[64];
+   snprintf( name, sizeof(name), "shader-%016llx.bin", hash );
+   return name;
+}
+
+// Returns a linked program, or 0 when there is no usable cached binary
+static GLuint
+loadProgramBinary(const std::string& path)
+{
+   FILE* fp = fopen( path.c_str(), "rb" );
+   if ( fp == NULL ) { return 0; }
+
+   char magic[4];
+   unsigned int format = 0, size = 0;
+   std::vector<char> binary;
+   bool ok = fread( magic, 1, 4, fp ) == 4 && memcmp( magic, programCacheMagic, 4 ) == 0 &&
+             fread( &format, sizeof(format), 1, fp ) == 1 && fread( &size, sizeof(size), 1, fp ) == 1 && size > 0;
+   if ( ok ) {
+      binary.resize( size );
+      ok = fread( &binary[0], 1, size, fp ) == size;
+   }
+   fclose( fp );
+   if ( !ok ) { return 0; }
+
+   GLuint program = glCreateProgram();
+   glProgramBinary( program, format, &binary[0], size );
+
+   GLint linked;
+   glGetProgramiv( program, GL_LINK_STATUS, &linked );
+   if ( !linked ) {
+      glDeleteProgram( program );
+      return 0;
+   }
+   return program;
+}
+
+static void
+saveProgramBinary(GLuint program, const std::string& path)
+{
+   GLint length = 0;
+   glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+   if ( length <= 0 ) { return; }
+
+   std::vector<char> binary( length );
+   GLenum format = 0;
+   glGetProgramBinary( program, length, NULL, &format, &binary[0] );
+
+   // a failed write only costs a compile on the next launch
+   FILE* fp = fopen( path.c_str(), "wb" );
+   if ( fp == NULL ) { return; }
+   unsigned int header[2] = { format, (unsigned int) length };
+   fwrite( programCacheMagic, 1, 4, fp );
+   fwrite( header, sizeof(header), 1, fp );
+   fwrite( &binary[0], 1, length, fp );
+   fclose( fp );
+}
+
+//----------------------------------------------------------------------------
+
+// Programs between BeginShader() and FinishShader()
+struct PendingProgram {
+   const char*  filenames[2];
+   GLuint       shaders[2];
+   std::string  cachePath;
+   bool         cacheable;
+   bool         fromCache;
+};
+
+static std::map<GLuint, PendingProgram> pendingPrograms;
+
+static bool
+parallelShaderCompile()
+{
+   return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+// Start building a GLSL program from vertex and fragment shader files. With
+// KHR/ARB_parallel_shader_compile the driver compiles and links on its own threads,
+// so the caller can do other start-up work before FinishShader().
 GLuint
-InitShader(const char* vShaderFile, const char* fShaderFile)
+BeginShader(const char* vShaderFile, const char* fShaderFile)
 {
+   StartupPhase phase( "BeginShader" );
+
    struct Shader {
       const char*  filename;
       GLenum       type;
@@ -40,8 +204,6 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
       { fShaderFile, GL_FRAGMENT_SHADER, NULL }
    };
 
-   GLuint program = glCreateProgram();
-    
    for ( int i = 0; i < 2; ++i ) {
       Shader& s = shaders[i];
       s.source = readShaderSource( s.filename );
@@ -49,15 +211,105 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
          std::cerr << "Failed to read " << s.filename << std::endl;
          exit( EXIT_FAILURE );
       }
+   }
+
+   PendingProgram pending;
+   pending.filenames[0] = vShaderFile;
+   pending.filenames[1] = fShaderFile;
+   pending.shaders[0] = pending.shaders[1] = 0;
+   pending.cacheable = programBinarySupported();
+   pending.fromCache = false;
 
-      GLuint shader = glCreateShader( s.type );
-      glShaderSource( shader, 1, (const GLchar**) &s.source, NULL );
-      glCompileShader( shader );
+   GLuint program = 0;
+   if ( pending.cacheable ) {
+      StartupPhase load( "load program binary" );
+      pending.cachePath = programCachePath( shaders[0].source, shaders[1].source );
+      program = loadProgramBinary( pending.cachePath );
+      pending.fromCache = program != 0;
+   }
+
+   if ( !pending.fromCache ) {
+      StartupPhase compile( "submit compile and link" );
+      static bool threadsSet = false;
+      if ( !threadsSet ) {
+         threadsSet = true;
+         // let the driver pick how many compiler threads to use
+         if ( GLEW_KHR_parallel_shader_compile ) {
+            glMaxShaderCompilerThreadsKHR( 0xffffffff );
+         } else if ( GLEW_ARB_parallel_shader_compile ) {
+            glMaxShaderCompilerThreadsARB( 0xffffffff );
+         }
+      }
 
+      program = glCreateProgram();
+      for ( int i = 0; i < 2; ++i ) {
+         Shader& s = shaders[i];
+         GLuint shader = glCreateShader( s.type );
+         glShaderSource( shader, 1, (const GLchar**) &s.source, NULL );
+         glCompileShader( shader );
+         glAttachShader( program, shader );
+         pending.shaders[i] = shader;
+      }
+      if ( pending.cacheable ) {
+         glProgramParameteri( program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+      }
+      glLinkProgram( program );
+   }
+
+   delete [] shaders[0].source;
+   delete [] shaders[1].source;
+
+   pendingPrograms[program] = pending;
+   return program;
+}
+
+// Whether a program from BeginShader() has finished compiling and linking, asked
+// with GL_COMPLETION_STATUS_KHR so it never waits for the driver. Without
+// KHR/ARB_parallel_shader_compile the driver cannot say, and it reports true.
+bool
+ShaderReady(GLuint program)
+{
+   std::map<GLuint, PendingProgram>::const_iterator it = pendingPrograms.find( program );
+   if ( it == pendingPrograms.end() || it->second.fromCache || !parallelShaderCompile() ) {
+      return true;
+   }
+   GLint done = GL_FALSE;
+   glGetProgramiv( program, GL_COMPLETION_STATUS_KHR, &done );
+   return done == GL_TRUE;
+}
+
+// Wait for a program from BeginShader(), check it and make it current. Compile and
+// link errors are reported here.
+GLuint
+FinishShader(GLuint program)
+{
+   StartupPhase phase( "FinishShader" );
+   PendingProgram pending = pendingPrograms[program];
+
+   if ( pending.fromCache ) {
+      pendingPrograms.erase( program );
+      glUseProgram( program );
+      return program;
+   }
+
+   // with parallel compiles the driver is polled, so the status queries below do not
+   // block; otherwise the first of them blocks until the driver is done
+   startup_trace_begin( "wait for the driver" );
+   if ( parallelShaderCompile() ) {
+      while ( !ShaderReady( program ) ) {
+         std::this_thread::yield();
+      }
+   }
+   pendingPrograms.erase( program );
+   for ( int i = 0; i < 2; ++i ) {
+      GLuint shader = pending.shaders[i];
       GLint  compiled;
       glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+      if ( i == 0 ) {
+         startup_trace_end();
+      }
       if ( !compiled ) {
-         std::cerr << s.filename << " failed to compile:" << std::endl;
+         std::cerr << pending.filenames[i] << " failed to compile:" << std::endl;
          GLint  logSize;
          glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logSize );
          char* logMsg = new char[logSize];
@@ -67,15 +319,9 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
 
          exit( EXIT_FAILURE );
       }
-
-      delete [] s.source;
-
-      glAttachShader( program, shader );
    }
 
-   /* link  and error check */
-   glLinkProgram(program);
-
+   /* link error check */
    GLint  linked;
    glGetProgramiv( program, GL_LINK_STATUS, &linked );
    if ( !linked ) {
@@ -90,40 +336,393 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
       exit( EXIT_FAILURE );
    }
 
+   if ( pending.cacheable ) {
+      StartupPhase save( "save program binary" );
+      saveProgramBinary( program, pending.cachePath );
+   }
+
    /* use program object */
    glUseProgram(program);
 
    return program;
 }
 
+// Create a GLSL program object from vertex and fragment shader files
+GLuint
+InitShader(const char* vShaderFile, const char* fShaderFile)
+{
+   return FinishShader( BeginShader( vShaderFile, fShaderFile ) );
+}
+
+//----------------------------------------------------------------------------
+// Frame timing for frame_stats. The GPU time comes from a ring of timer queries
+// that are read back a few frames later, so the CPU never waits for them.
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const int gpuTimerCount = 4;
+static GLuint gpuTimers[gpuTimerCount];
+static bool gpuTimerIssued[gpuTimerCount];
+static int gpuTimerNext = 0;
+
+static Clock::time_point lastDisplay;
+static bool displayed = false;
+static long displayedFrames = 0;
+
+static double
+msBetween(Clock::time_point start, Clock::time_point end)
+{
+   return std::chrono::duration<double, std::milli>( end - start ).count();
+}
+
+static bool
+gpuTimersSupported()
+{
+   return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+// Starts timing this frame on the GPU. Returns the time of the frame that last used
+// the query, or -1 when it is not known (yet).
+static double
+beginGpuTimer()
+{
+   if ( !gpuTimersSupported() ) { return -1.0; }
+   if ( gpuTimers[0] == 0 ) {
+      glGenQueries( gpuTimerCount, gpuTimers );
+   }
+
+   int slot = gpuTimerNext;
+   gpuTimerNext = ( gpuTimerNext + 1 ) % gpuTimerCount;
+   double ms = -1.0;
+   if ( gpuTimerIssued[slot] ) {
+      GLint available = 0;
+      glGetQueryObjectiv( gpuTimers[slot], GL_QUERY_RESULT_AVAILABLE, &available );
+      if ( available ) {
+         GLuint64 ns = 0;
+         glGetQueryObjectui64v( gpuTimers[slot], GL_QUERY_RESULT, &ns );
+         ms = ns * 1e-6;
+      }
+   }
+   glBeginQuery( GL_TIME_ELAPSED, gpuTimers[slot] );
+   gpuTimerIssued[slot] = true;
+   return ms;
+}
+
+//----------------------------------------------------------------------------
+// Flight recording: --record FILE saves the simulation state of every frame (see
+// flight_recorder.h); --replay FILE draws the recorded state instead of simulating,
+// looping over the recording from --replay-from FRAME, so rendering can be timed
+// on its own (e.g. with --frames N --no-capture).
+
+static const char* recordPath = NULL;
+static const char* replayPath = NULL;
+static long replayFrom = 0;
+
+static void
+closeFlightRecorder()
+{
+   if ( !flight_recorder.active() ) { return; }
+   flight_recorder.close();
+#ifdef DEBUG
+   const FlightRecorderStats& stats = flight_recorder.stats();
+   std::cout << "flight recorder: " << stats.frames << " frames, " << stats.bytes << " bytes ("
+             << ( stats.bytes > 0 ? double( stats.raw_bytes ) / stats.bytes : 0.0 ) << "x smaller than floats), "
+             << ( stats.frames > 0 ? stats.encode_ms / stats.frames : 0.0 ) << " ms per frame" << std::endl;
+#endif
+}
+
+// Before init(), which looks up the channels it replays
+static void
+openReplay()
+{
+   if ( replayPath == NULL ) { return; }
+   if ( !flight_playback.open( replayPath ) || flight_playback.frames() == 0 ) {
+      std::cerr << "cannot replay " << replayPath << std::endl;
+      exit( EXIT_FAILURE );
+   }
+}
+
+// After init(), which declares the channels it records
+static void
+openRecording()
+{
+   if ( recordPath == NULL ) { return; }
+   if ( !flight_recorder.open( recordPath ) ) {
+      std::cerr << "cannot record to " << recordPath << std::endl;
+      exit( EXIT_FAILURE );
+   }
+   // the demos quit with exit() from keyboard()
+   atexit( closeFlightRecorder );
+}
+
+static long
+replayFrame()
+{
+   long first = flight_playback.first_frame(), span = flight_playback.last_frame() - first + 1;
+   return first + ( replayFrom + displayedFrames ) % span;
+}
+
+//----------------------------------------------------------------------------
+
+// Records the frame in frame_stats; the first one also ends the start-up trace once
+// it has reached the screen
+static void
+displayAndReport()
+{
+   Clock::time_point start = Clock::now();
+   double gpu_ms = beginGpuTimer();
+
+   if ( flight_playback.active() ) {
+      flight_playback.seek( replayFrame() );
+   }
+   flight_recorder.begin_frame( displayedFrames, FrameTime() );
+
+   bool firstFrame = startup_trace_active();
+   if ( firstFrame ) {
+      startup_trace_begin( "first frame" );
+   }
+   display();
+   flight_recorder.end_frame();
+   ++displayedFrames;
+   if ( gpuTimersSupported() ) {
+      glEndQuery( GL_TIME_ELAPSED );
+   }
+   if ( firstFrame ) {
+      startup_trace_end();
+      startup_trace_first_frame();
+   }
+
+   // total: from the previous frame to this one
+   frame_stats.end_frame( gpu_ms, displayed ? msBetween( lastDisplay, start ) : -1.0 );
+   hud.record_frame( frame_stats.last_frame() );
+
+   // the demo sets its own counters during display()
+   const FrameSample& frame = frame_stats.last_frame();
+   telemetry.set( "frame_ms", frame.ms[FRAME_TOTAL] );
+   telemetry.set( "frame_p99_ms", frame_stats.summary().window[FRAME_TOTAL].p99 );
+   telemetry.set( "sim_ms", frame.ms[FRAME_SIM] );
+   telemetry.set( "submit_ms", frame.ms[FRAME_SUBMIT] );
+   telemetry.set( "gpu_ms", frame.ms[FRAME_GPU] );
+   telemetry.publish();
+   lastDisplay = start;
+   displayed = true;
+}
+
+//----------------------------------------------------------------------------
+// Offline rendering: --frames N runs update() and display() for N frames as fast
+// as they go, from the idle callback instead of the frame timer, on a virtual
+// clock of --fps frames per second (60 by default). Every frame, or every Kth with
+// --capture-every K, is written through frame_capture as frame_<number>, blocking
+// rather than dropping (see CaptureSettings for the format and directory), unless
+// --no-capture. With the same --seed the frames are bit-identical from run to run
+// on the same driver; make golden compares them with stored references.
+// --baseline draws the unoptimized way instead (see BaselineRendering()), which
+// make golden-baseline compares with the optimized frames.
+
+struct OfflineSettings {
+   long    frames;    // 0: interactive
+   double  fps;
+   bool    capture;
+   long    captureEvery;
+};
+
+static OfflineSettings offline = { 0, 60.0, true, 1 };
+static long offlineFrame = 0;
+static Clock::time_point offlineStart;
+static unsigned randomSeed = 1;
+static bool baselineRendering = false;
+static std::chrono::steady_clock::time_point startTime;
+static bool reshaped = false;
+
+double
+FrameTime()
+{
+   if ( offline.frames > 0 ) { return offlineFrame / offline.fps; }
+   return std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+unsigned
+RandomSeed()
+{
+   return randomSeed;
+}
+
+bool
+OfflineRendering()
+{
+   return offline.frames > 0;
+}
+
+bool
+BaselineRendering()
+{
+   return baselineRendering;
+}
+
+void
+PresentFrame()
+{
+   if ( offline.frames == 0 ) {
+      frame_capture.capture();
+   } else if ( offlineFrame % offline.captureEvery == 0 ) {
+      frame_capture.capture( offlineFrame );
+   }
+   // offline frames are read from the back buffer; a swap a second shows progress
+   // without waiting for vsync every frame
+   if ( offline.frames == 0 || offlineFrame % std::max( 1L, long( offline.fps ) ) == 0 ) {
+      glutSwapBuffers();
+   }
+}
+
 void
 timer(int unused)
 {
+   Clock::time_point start = Clock::now();
    update();
+   frame_stats.add_sim_ms( msBetween( start, Clock::now() ) );
    glutPostRedisplay();
    glutTimerFunc( FRAME_RATE_MS, timer, 0 );
 }
 
+static void
+reshapeAndMark(int width, int height)
+{
+   reshape( width, height );
+   reshaped = true;
+}
+
+// Frames are only drawn by offlineStep(); the demos simulate in display(), so an
+// extra redraw from the window system would change the sequence
+static void
+offlineExpose()
+{
+}
+
+static void
+offlineStep()
+{
+   if ( !reshaped ) { return; }   // the window is not up yet
+   if ( offlineFrame == 0 ) {
+      if ( offline.capture ) {
+         CaptureSettings settings = CaptureSettings::from_environment();
+         settings.policy = CAPTURE_BLOCK;
+         frame_capture.start( settings );
+      }
+      offlineStart = Clock::now();
+   }
+
+   Clock::time_point start = Clock::now();
+   update();
+   frame_stats.add_sim_ms( msBetween( start, Clock::now() ) );
+   displayAndReport();
+   if ( ++offlineFrame < offline.frames ) { return; }
+
+   // includes waiting for the last frames to be written
+   frame_capture.stop();
+   double seconds = msBetween( offlineStart, Clock::now() ) * 1e-3;
+   std::cout << "offline: " << offline.frames << " frames (" << offline.frames / offline.fps
+             << " s of animation) in " << seconds << " s, " << offline.frames / seconds << " fps, "
+             << offline.frames / offline.fps / seconds << "x real time" << std::endl;
+   frame_stats.stop();
+   FrameStatsSummary summary = frame_stats.summary();
+   std::cout << "offline: frame p50 " << summary.run[FRAME_TOTAL].p50 << " ms, p99 " << summary.run[FRAME_TOTAL].p99
+             << " ms; submit p50 " << summary.run[FRAME_SUBMIT].p50 << " ms, sim p50 " << summary.run[FRAME_SIM].p50
+             << " ms" << std::endl;
+   exit( EXIT_SUCCESS );
+}
+
+static void
+parseArguments(int argc, char** argv)
+{
+   bool valid = true;
+   for ( int i = 1; i < argc; ++i ) {
+      const char* arg = argv[i];
+      const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+      if ( strcmp( arg, "--frames" ) == 0 && value != NULL && atol( value ) > 0 ) {
+         offline.frames = atol( value );
+         ++i;
+      } else if ( strcmp( arg, "--fps" ) == 0 && value != NULL && atof( value ) > 0.0 ) {
+         offline.fps = atof( value );
+         ++i;
+      } else if ( strcmp( arg, "--seed" ) == 0 && value != NULL ) {
+         randomSeed = (unsigned) strtoul( value, NULL, 10 );
+         ++i;
+      } else if ( strcmp( arg, "--capture-every" ) == 0 && value != NULL && atol( value ) > 0 ) {
+         offline.captureEvery = atol( value );
+         ++i;
+      } else if ( strcmp( arg, "--no-capture" ) == 0 ) {
+         offline.capture = false;
+      } else if ( strcmp( arg, "--baseline" ) == 0 ) {
+         baselineRendering = true;
+      } else if ( strcmp( arg, "--record" ) == 0 && value != NULL ) {
+         recordPath = value;
+         ++i;
+      } else if ( strcmp( arg, "--replay" ) == 0 && value != NULL ) {
+         replayPath = value;
+         ++i;
+      } else if ( strcmp( arg, "--replay-from" ) == 0 && value != NULL && atol( value ) >= 0 ) {
+         replayFrom = atol( value );
+         ++i;
+      } else {
+         valid = false;
+      }
+   }
+   if ( !valid || ( recordPath != NULL && replayPath != NULL ) ) {
+      std::cerr << "usage: " << argv[0] << " [--frames N [--fps F] [--capture-every K | --no-capture]] [--seed S]"
+                << " [--baseline] [--record FILE | --replay FILE [--replay-from FRAME]]" << std::endl;
+      exit( EXIT_FAILURE );
+   }
+}
+
 int
 main( int argc, char **argv )
 {
+   startup_trace_begin( "glutInit" );
    glutInit( &argc, argv );
+   startup_trace_end();
+   parseArguments( argc, argv );
+   srand( randomSeed );
+
+   startup_trace_begin( "create window" );
    glutInitDisplayMode( GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH );
    glutInitWindowSize( 640, 640 );
    glutInitContextVersion( 3, 2 );
    glutInitContextProfile( GLUT_CORE_PROFILE );
    glutCreateWindow( WINDOW_TITLE );
+   startup_trace_end();
 
+   startup_trace_begin( "glewInit" );
    glewInit();
+   startup_trace_end();
 
+   openReplay();
+   startup_trace_begin( "init" );
    init();
+   startup_trace_end();
+   openRecording();
+
+   startup_trace_begin( "hud" );
+   hud.init();
+   startup_trace_end();
 
-   glutDisplayFunc( display );
    glutKeyboardFunc( keyboard );
-   glutMouseFunc( mouse );
-   glutReshapeFunc( reshape );
-   glutTimerFunc( FRAME_RATE_MS, timer, 0 );
-   
+   glutReshapeFunc( reshapeAndMark );
+   if ( offline.frames > 0 ) {
+      glutDisplayFunc( offlineExpose );
+      glutIdleFunc( offlineStep );
+   } else {
+      glutDisplayFunc( displayAndReport );
+      glutMouseFunc( mouse );
+      glutTimerFunc( FRAME_RATE_MS, timer, 0 );
+   }
+
+   frame_stats.start();
+   startTime = std::chrono::steady_clock::now();
+   if ( telemetry.open() ) {
+#ifdef DEBUG
+      std::cout << "telemetry in " << telemetry.name() << " (make tools && ../build/tool_telemetry)" << std::endl;
+#endif
+   }
    glutMainLoop();
    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+// Background chunk meshing
+
+#include "mesh_pipeline.h"
+
+#include <algorithm>
+
+MeshPipeline::MeshPipeline(int num_workers, int pool_size)
+	: free_jobs(pool_size), todo(pool_size), done(pool_size), running(true), next_sequence(0) {
+	for (int i = 0; i < pool_size; i++) {
+		jobs.push_back(new MeshJob());
+		free_jobs.push(jobs.back());
+	}
+
+	if (num_workers <= 0)
+		num_workers = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+	for (int i = 0; i < num_workers; i++)
+		workers.push_back(std::thread(&MeshPipeline::worker_loop, this));
+}
+
+MeshPipeline::~MeshPipeline() {
+	running = false;
+	for (std::thread &worker : workers)
+		worker.join();
+	for (MeshJob *job : jobs)
+		delete job;
+}
+
+void MeshPipeline::worker_loop() {
+	int idle = 0;
+	while (running) {
+		MeshJob *job;
+		if (!todo.pop(job)) {
+			// back off from spinning to sleeping while there is nothing to do
+			if (++idle < 64)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		idle = 0;
+		job->vertices.clear();
+		mesh_chunk(job->padded, job->vertices);
+		mesh_bounds(job->vertices, job->bounds_lo, job->bounds_hi);
+		opaque_layers(job->padded, job->solid_lo, job->solid_hi);
+		job->meshed = std::chrono::high_resolution_clock::now();
+		done.push(job);
+	}
+}
+
+bool MeshPipeline::submit(const World &world, ChunkPos pos) {
+	MeshJob *job;
+	if (!free_jobs.pop(job))
+		return false;
+	job->pos = pos;
+	job->sequence = ++next_sequence;
+	world.gather_padded(pos, job->padded);
+	job->submitted = std::chrono::high_resolution_clock::now();
+	todo.push(job);
+	return true;
+}
+
+MeshJob *MeshPipeline::poll() {
+	MeshJob *job;
+	return done.pop(job) ? job : NULL;
+}
+
+void MeshPipeline::release(MeshJob *job) {
+	free_jobs.push(job);
+}
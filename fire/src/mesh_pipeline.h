@@ -0,0 +1,57 @@
+// Background chunk meshing
+//
+// The GL thread copies a dirty chunk (plus its border) into a pooled MeshJob and
+// submits it; worker threads greedy-mesh the copy into the job's vertex buffer and
+// hand it back through a lock-free queue. The GL thread polls finished jobs,
+// uploads them and releases them back to the pool. Jobs carry a sequence number so
+// an older mesh of a chunk that was edited again never overwrites a newer one.
+
+#ifndef MESH_PIPELINE_H
+#define MESH_PIPELINE_H
+
+#include "chunk.h"
+#include "lockfree_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+struct MeshJob {
+	ChunkPos pos;
+	unsigned long sequence;
+	BlockId padded[PADDED_VOLUME];
+	std::vector<BlockVertex> vertices;    // capacity is kept between uses
+	glm::vec3 bounds_lo, bounds_hi;       // of the vertices, see mesh_bounds()
+	int solid_lo, solid_hi;               // opaque y layers, see opaque_layers()
+	std::chrono::high_resolution_clock::time_point submitted, meshed;
+};
+
+class MeshPipeline {
+	std::vector<MeshJob *> jobs;
+	std::vector<std::thread> workers;
+	MpmcQueue<MeshJob *> free_jobs, todo, done;
+	std::atomic<bool> running;
+	unsigned long next_sequence;
+
+	void worker_loop();
+
+	MeshPipeline(const MeshPipeline &);
+	MeshPipeline &operator=(const MeshPipeline &);
+
+public:
+	// num_workers <= 0 picks one less than the number of hardware threads
+	MeshPipeline(int num_workers, int pool_size);
+	~MeshPipeline();
+
+	int num_workers() const { return int(workers.size()); }
+
+	// Copies the chunk out of the world and queues it; false when every job is in use
+	bool submit(const World &world, ChunkPos pos);
+
+	// A finished job, or NULL; hand it back with release() once uploaded
+	MeshJob *poll();
+	void release(MeshJob *job);
+};
+
+#endif // MESH_PIPELINE_H
@@ -0,0 +1,64 @@
+// Software occlusion culling
+//
+// Known-solid boxes (terrain slabs, robot torsos) are rasterized on the CPU into a
+// small depth buffer, four pixels at a time with SSE. A max-depth pyramid is built on
+// top of it, so a bounding box is tested by projecting it to a screen rectangle and
+// comparing its nearest depth with a handful of texels from the pyramid level where
+// the rectangle spans at most two texels. A box is only reported hidden when every
+// texel under it holds an occluder closer than the box's nearest point.
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "affine.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+
+struct OcclusionStats {
+	int occluders;           // boxes rasterized this frame
+	int triangles;           // front facing triangles rasterized after near-plane clipping
+	int tested;
+	int occluded;
+	double raster_ms;        // rasterizing plus building the pyramid
+};
+
+class OcclusionBuffer {
+	int width, height;       // level 0; multiples of 4
+	glm::mat4 view_projection;
+	std::vector<std::vector<float> > levels;   // [0] is full resolution, depth in [0, 1]
+	std::vector<glm::ivec2> level_sizes;       // halved rounding up, so texel x >> k is in level k
+	bool dirty;              // occluders added since the pyramid was built
+	OcclusionStats current;
+
+	// facing is +1 to keep counter-clockwise triangles, -1 to keep clockwise ones
+	void rasterize_triangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c, float facing);
+	void build_pyramid();
+
+public:
+	explicit OcclusionBuffer(int width = OCCLUSION_WIDTH, int height = OCCLUSION_HEIGHT);
+
+	// Clears the buffer for a new frame
+	void begin(const glm::mat4 &view_projection);
+
+	// The box [lo, hi] in the space of model, which must be completely opaque
+	void add_occluder_box(const Affine &model, const glm::vec3 &lo, const glm::vec3 &hi);
+
+	// False only when the world space box is certainly hidden behind occluders
+	bool test_box(const glm::vec3 &lo, const glm::vec3 &hi);
+
+	bool has_occluders() const { return current.occluders > 0; }
+	const OcclusionStats &stats() const { return current; }
+	const float *depth() const { return &levels[0][0]; }
+	int buffer_width() const { return width; }
+	int buffer_height() const { return height; }
+};
+
+// The buffer flush_draws() tests queued draws against; cleared by set_frame_uniforms()
+extern OcclusionBuffer occlusion_buffer;
+
+#endif // OCCLUSION_H
@@ -0,0 +1,51 @@
+// Adaptive particle budget
+
+#include "particle_budget.h"
+
+#include <algorithm>
+
+ParticleBudget::ParticleBudget(const ParticleBudgetSettings &settings) : calm(0), settle(0), primed(false), settings(settings) {
+	current.sim_ms = current.render_ms = current.frame_ms = 0.0;
+	current.headroom_ms = settings.target_ms;
+	current.scale = std::min(std::max(1.0f, settings.min_scale), settings.max_scale);
+	current.changes = 0;
+}
+
+bool ParticleBudget::record(double sim_ms, double render_ms) {
+	if (!primed) {
+		current.sim_ms = sim_ms;
+		current.render_ms = render_ms;
+		primed = true;
+	} else {
+		current.sim_ms += settings.smoothing * (sim_ms - current.sim_ms);
+		current.render_ms += settings.smoothing * (render_ms - current.render_ms);
+	}
+	current.frame_ms = current.sim_ms + current.render_ms;
+	current.headroom_ms = settings.target_ms - current.frame_ms;
+
+	if (settle > 0) {
+		settle--;
+		return false;
+	}
+
+	float scale = current.scale;
+	if (current.frame_ms > settings.target_ms * (1.0 + settings.band)) {
+		scale *= settings.decrease;
+		calm = 0;
+	} else if (current.frame_ms < settings.target_ms * (1.0 - settings.band)) {
+		if (++calm >= settings.calm_frames) {
+			scale *= settings.increase;
+			calm = 0;
+		}
+	} else {
+		calm = 0;
+	}
+	scale = std::min(std::max(scale, settings.min_scale), settings.max_scale);
+
+	if (scale == current.scale)
+		return false;
+	current.scale = scale;
+	current.changes++;
+	settle = settings.settle_frames;
+	return true;
+}
@@ -0,0 +1,54 @@
+// Adaptive particle budget
+//
+// Each frame the measured simulation and render (CPU submission) times are fed in;
+// the controller smooths them and moves a budget scale between the user limits to
+// hold the target frame time. The scale multiplies the emission rates and the live
+// particle caps. It drops quickly when a frame runs over the target and rises slowly
+// after a run of frames with headroom; inside the hysteresis band it holds still, so
+// the budget does not oscillate around the target.
+
+#ifndef PARTICLE_BUDGET_H
+#define PARTICLE_BUDGET_H
+
+struct ParticleBudgetSettings {
+	double target_ms;          // frame time to hold
+	float min_scale;           // user limits on the budget scale
+	float max_scale;
+	double band;               // hysteresis: hold while within target * (1 +- band)
+	float decrease;            // scale factor applied when over budget
+	float increase;            // scale factor applied after calm_frames under budget
+	int calm_frames;
+	int settle_frames;         // frames to hold after a change while the average catches up
+	double smoothing;          // weight of the newest frame in the moving average
+
+	ParticleBudgetSettings() : target_ms(1000.0 / 60.0), min_scale(0.1f), max_scale(2.0f), band(0.1),
+	                           decrease(0.85f), increase(1.05f), calm_frames(30), settle_frames(10), smoothing(0.1) {}
+};
+
+struct ParticleBudgetStats {
+	double sim_ms;             // smoothed
+	double render_ms;          // smoothed
+	double frame_ms;           // sim + render
+	double headroom_ms;        // target - frame; negative when over budget
+	float scale;
+	int changes;               // budget changes since the start
+};
+
+class ParticleBudget {
+	ParticleBudgetStats current;
+	int calm, settle;
+	bool primed;
+
+public:
+	ParticleBudgetSettings settings;
+
+	explicit ParticleBudget(const ParticleBudgetSettings &settings = ParticleBudgetSettings());
+
+	// Returns true when the scale changed
+	bool record(double sim_ms, double render_ms);
+
+	float scale() const { return current.scale; }
+	const ParticleBudgetStats &stats() const { return current; }
+};
+
+#endif // PARTICLE_BUDGET_H
@@ -0,0 +1,80 @@
+// Live telemetry in shared memory
+//
+// Named counters (frame times, draw calls, particle counts, ...) are published once
+// per frame into a POSIX shared memory block, /block-anim-<pid> (/dev/shm on Linux),
+// so a running demo can be watched from outside with tool_telemetry. The block is
+// guarded by a seqlock: the single writer bumps the sequence to odd, copies the
+// counters and bumps it to even, so publishing never waits on a reader; readers
+// retry when the sequence was odd or changed under them. Not available on Windows,
+// where open() fails and the other calls do nothing.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <cstdint>
+
+const int TELEMETRY_COUNTERS = 32;
+const int TELEMETRY_NAME_LENGTH = 24;     // including the terminator
+const uint32_t TELEMETRY_VERSION = 1;
+
+// The shared layout; TELEMETRY_VERSION changes with it
+struct TelemetryBlock {
+	char magic[8];                        // "BATELEM"
+	uint32_t version;
+	uint32_t pid;
+	std::atomic<uint64_t> sequence;       // odd while the writer is copying
+
+	// guarded by sequence
+	uint64_t frame;
+	double seconds;                       // since open()
+	uint32_t counters;
+	char names[TELEMETRY_COUNTERS][TELEMETRY_NAME_LENGTH];
+	double values[TELEMETRY_COUNTERS];
+};
+
+// A consistent copy of the guarded part of a block
+struct TelemetrySnapshot {
+	uint64_t frame;
+	double seconds;
+	uint32_t counters;
+	char names[TELEMETRY_COUNTERS][TELEMETRY_NAME_LENGTH];
+	double values[TELEMETRY_COUNTERS];
+};
+
+class Telemetry {
+	TelemetryBlock *block;
+	char shm_name[32];
+	TelemetrySnapshot staging;            // render thread only
+	const char *keys[TELEMETRY_COUNTERS]; // the name pointers last passed to set()
+	double open_time;
+
+	Telemetry(const Telemetry &);
+	Telemetry &operator=(const Telemetry &);
+
+public:
+	Telemetry();
+	~Telemetry();
+
+	// Creates the block; false when shared memory is unavailable
+	bool open();
+	// Removes the block (also done on exit)
+	void close();
+
+	// Sets a counter for the next publish(); the first set of a name adds it. Names
+	// past TELEMETRY_COUNTERS are ignored.
+	void set(const char *name, double value);
+
+	// Copies the counters into the block. Wait-free.
+	void publish();
+
+	const char *name() const { return shm_name; }
+};
+
+extern Telemetry telemetry;
+
+// Reader side (tool_telemetry). Returns false when no consistent copy could be
+// taken within a few thousand attempts, e.g. because the writer died mid-copy.
+extern bool telemetry_read(const TelemetryBlock *block, TelemetrySnapshot &snapshot);
+
+#endif // TELEMETRY_H
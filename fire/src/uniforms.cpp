@@ -0,0 +1,227 @@
+// Uniform buffer objects and batched draw submission
+
+#include "uniforms.h"
+#include "frustum.h"
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static GLuint frame_ubo, draw_ubo;
+static GLint ubo_alignment = 256;
+
+struct QueuedDraw {
+	Mesh mesh;
+	bool outline;
+	bool occlusion_tested; // by the caller, see submit_tested_draw()
+	size_t group;          // order of the first draw with the same mesh
+	DrawUniforms data;
+};
+
+struct DrawRun {
+	size_t first, count, offset;
+};
+
+static std::vector<QueuedDraw> queued_draws;
+static std::vector<DrawRun> draw_runs;
+static std::vector<unsigned char> staging;
+
+static Frustum frame_frustum;
+static std::vector<float> cull_x, cull_y, cull_z, cull_r;
+static std::vector<uint8_t> cull_visible;
+CullStats cull_stats;
+
+static bool same_batch(const QueuedDraw &a, const QueuedDraw &b) {
+	return a.mesh.vao == b.mesh.vao && a.mesh.first == b.mesh.first && a.mesh.count == b.mesh.count && a.outline == b.outline;
+}
+
+// Group of each batch key seen this frame: an open-addressing table of at least
+// twice the queued draws, kept between frames. Slots from earlier frames carry an
+// older stamp, so the table is emptied by bumping the stamp.
+struct BatchSlot {
+	GLuint vao;
+	GLsizei first, count;
+	bool outline;
+	unsigned stamp;
+	size_t group;
+};
+
+static std::vector<BatchSlot> batch_slots;
+static unsigned batch_stamp;
+
+static size_t batch_group(const QueuedDraw &draw, size_t &groups) {
+	size_t mask = batch_slots.size() - 1;
+	size_t h = (size_t(draw.mesh.vao) * 0x9E3779B1u) ^ (size_t(draw.mesh.first) * 0x85EBCA77u) ^ size_t(draw.mesh.count) ^ size_t(draw.outline);
+	for (size_t i = h & mask; ; i = (i + 1) & mask) {
+		BatchSlot &slot = batch_slots[i];
+		if (slot.stamp != batch_stamp) {
+			BatchSlot fresh = { draw.mesh.vao, draw.mesh.first, draw.mesh.count, draw.outline, batch_stamp, groups++ };
+			slot = fresh;
+			return slot.group;
+		}
+		if (slot.vao == draw.mesh.vao && slot.first == draw.mesh.first && slot.count == draw.mesh.count && slot.outline == draw.outline)
+			return slot.group;
+	}
+}
+
+// Numbers the distinct batch keys in the order they are first queued
+static void assign_batch_groups() {
+	size_t slots = batch_slots.empty() ? 64 : batch_slots.size();
+	while (slots < 2 * queued_draws.size())
+		slots *= 2;
+	if (++batch_stamp == 0 || slots != batch_slots.size()) {
+		batch_slots.assign(slots, BatchSlot());
+		batch_stamp = 1;
+	}
+	size_t groups = 0;
+	const QueuedDraw *previous = NULL;
+	for (QueuedDraw &draw : queued_draws) {
+		// runs of the same mesh are the common case
+		draw.group = previous != NULL && same_batch(*previous, draw) ? previous->group : batch_group(draw, groups);
+		previous = &draw;
+	}
+}
+
+static bool group_less(const QueuedDraw &a, const QueuedDraw &b) {
+	return a.group < b.group;
+}
+
+void init_uniform_blocks(GLuint program) {
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FrameBlock"), FrameBlockBinding);
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "DrawBlock"), DrawBlockBinding);
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_alignment);
+
+	glGenBuffers(1, &frame_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, frame_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameBlockBinding, frame_ubo);
+
+	glGenBuffers(1, &draw_ubo);
+}
+
+void set_frame_uniforms(const FrameUniforms &frame) {
+	frame_frustum = frustum_from_matrix(frame.projection * frame.view);
+	occlusion_buffer.begin(frame.projection * frame.view);
+	glBindBuffer(GL_UNIFORM_BUFFER, frame_ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+}
+
+void submit_draw(const Mesh &mesh, const Affine &model, const glm::vec4 &color, int flags, bool outline, const glm::vec4 &spin) {
+	QueuedDraw draw;
+	draw.mesh = mesh;
+	draw.outline = outline;
+	draw.occlusion_tested = false;
+	draw.data.model = model;
+	draw.data.color = color;
+	draw.data.spin = spin;
+	draw.data.flags = glm::ivec4(flags, 0, 0, 0);
+	queued_draws.push_back(draw);
+}
+
+void submit_tested_draw(const Mesh &mesh, const Affine &model, const glm::vec4 &color, int flags) {
+	submit_draw(mesh, model, color, flags);
+	queued_draws.back().occlusion_tested = true;
+}
+
+// World space bounding spheres of the queued draws, tested in one batch against the
+// frustum and then one by one against the occluders; culled draws are removed in
+// place, keeping submission order
+static void cull_draws() {
+	size_t n = queued_draws.size();
+	cull_x.resize(n);
+	cull_y.resize(n);
+	cull_z.resize(n);
+	cull_r.resize(n);
+	cull_visible.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		const QueuedDraw &draw = queued_draws[i];
+		const Affine &m = draw.data.model;
+		glm::vec3 center = m.transform_point(glm::vec3(draw.mesh.bounds));
+		float scale2 = 0.0f;
+		for (int j = 0; j < 3; j++)
+			scale2 = std::max(scale2, m.rows[0][j] * m.rows[0][j] + m.rows[1][j] * m.rows[1][j] + m.rows[2][j] * m.rows[2][j]);
+		cull_x[i] = center.x;
+		cull_y[i] = center.y;
+		cull_z[i] = center.z;
+		cull_r[i] = draw.mesh.bounds.w * std::sqrt(scale2);
+	}
+	frustum_test_spheres(frame_frustum, &cull_x[0], &cull_y[0], &cull_z[0], &cull_r[0], int(n), &cull_visible[0]);
+
+	bool occluders = occlusion_buffer.has_occluders();
+	size_t kept = 0, in_frustum = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (!cull_visible[i])
+			continue;
+		in_frustum++;
+		if (occluders && !queued_draws[i].occlusion_tested) {
+			glm::vec3 center(cull_x[i], cull_y[i], cull_z[i]), extent(cull_r[i]);
+			if (!occlusion_buffer.test_box(center - extent, center + extent))
+				continue;
+		}
+		queued_draws[kept++] = queued_draws[i];
+	}
+	queued_draws.resize(kept);
+
+	cull_stats.tested = int(n);
+	cull_stats.culled = int(n - in_frustum);
+	cull_stats.occluded = int(in_frustum - kept);
+	cull_stats.drawn = int(kept);
+}
+
+void flush_draws(bool cull) {
+	cull_stats.tested = cull_stats.culled = cull_stats.occluded = cull_stats.drawn = cull_stats.batches = 0;
+	if (queued_draws.empty())
+		return;
+
+	if (cull)
+		cull_draws();
+	else
+		cull_stats.tested = cull_stats.drawn = int(queued_draws.size());
+	if (queued_draws.empty())
+		return;
+
+	assign_batch_groups();
+	std::stable_sort(queued_draws.begin(), queued_draws.end(), group_less);
+
+	// lay each run out at an aligned offset so it can be bound with glBindBufferRange
+	const size_t block_size = MAX_DRAWS * sizeof(DrawUniforms);
+	size_t cursor = 0;
+	draw_runs.clear();
+	for (size_t i = 0; i < queued_draws.size(); ) {
+		size_t j = i + 1;
+		while (j < queued_draws.size() && j - i < MAX_DRAWS && same_batch(queued_draws[i], queued_draws[j]))
+			j++;
+		cursor = (cursor + ubo_alignment - 1) / ubo_alignment * ubo_alignment;
+		DrawRun run = { i, j - i, cursor };
+		draw_runs.push_back(run);
+		cursor += run.count * sizeof(DrawUniforms);
+		i = j;
+	}
+
+	cull_stats.batches = int(draw_runs.size());
+
+	// the bound range always covers the whole declared block
+	staging.resize(draw_runs.back().offset + block_size);
+	for (const DrawRun &run : draw_runs) {
+		DrawUniforms *dst = (DrawUniforms *)&staging[run.offset];
+		for (size_t k = 0; k < run.count; k++)
+			dst[k] = queued_draws[run.first + k].data;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, draw_ubo);
+	glBufferData(GL_UNIFORM_BUFFER, staging.size(), &staging[0], GL_STREAM_DRAW);
+
+	for (const DrawRun &run : draw_runs) {
+		const QueuedDraw &draw = queued_draws[run.first];
+		glBindBufferRange(GL_UNIFORM_BUFFER, DrawBlockBinding, draw_ubo, run.offset, block_size);
+		glBindVertexArray(draw.mesh.vao);
+		if (draw.outline)
+			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		glDrawElementsInstanced(GL_TRIANGLES, draw.mesh.count, GL_UNSIGNED_INT, BUFFER_OFFSET(draw.mesh.first * sizeof(GLuint)), run.count);
+		if (draw.outline)
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	}
+
+	queued_draws.clear();
+}
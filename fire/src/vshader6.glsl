@@ -1,18 +1,46 @@
 #version 150
 
+#define MAX_DRAWS 128
+
+struct DrawData {
+    mat3x4 model;          // rows of an affine transform
+    vec4 color;
+    vec4 spin;             // axis, angle
+    ivec4 flags;
+};
+
+layout(std140) uniform FrameBlock {
+    mat4 Projection;
+    mat4 View;
+    vec4 Time;
+};
+
+layout(std140) uniform DrawBlock {
+    DrawData draws[MAX_DRAWS];
+};
+
 in vec4 vPosition;
 in vec2 uv;
-uniform mat4 ModelView, Projection;
-uniform int UseTexture;
+in vec4 block_color;
 
 out vec2 uv_pos;
+flat out vec4 draw_color;
 flat out int use_texture;
 
 
+// Rotate p by spin.w radians about the unit axis spin.xyz (identity for a zero spin)
+vec3 spin_rotate(vec4 spin, vec3 p)
+{
+    float c = cos(spin.w), s = sin(spin.w);
+    return p * c + cross(spin.xyz, p) * s + spin.xyz * dot(spin.xyz, p) * (1.0 - c);
+}
+
 void main()
 {
-    gl_Position = Projection * ModelView * vPosition;
+    DrawData draw = draws[gl_InstanceID];
+    vec4 local = vec4(spin_rotate(draw.spin, vPosition.xyz), 1.0);
+    gl_Position = Projection * View * vec4(local * draw.model, 1.0);
     uv_pos = uv;
-    use_texture = UseTexture;
+    draw_color = draw.color * block_color;
+    use_texture = draw.flags.x;
 }
-
@@ -0,0 +1,214 @@
+// GPU side of the block world
+
+#include "world_render.h"
+#include "mesh_pipeline.h"
+#include "uniforms.h"
+#include "occlusion.h"
+
+#include <thread>
+#include <vector>
+
+const int mesh_pool_size = 64;
+
+struct ChunkMesh {
+	GLuint vao, vbo;
+	GLsizei index_count;
+	long vertex_bytes;
+	unsigned long sequence;  // of the uploaded mesh job
+	glm::vec3 lo, hi;        // bounds of the vertices, in block units
+	int solid_lo, solid_hi;  // completely opaque y layers, used as an occluder
+};
+
+WorldRenderStats world_render_stats;
+
+static std::unordered_map<ChunkPos, ChunkMesh, ChunkPosHash> chunk_meshes;
+static GLuint quad_indices;
+static GLuint vPosition, uv, block_color;
+
+static MeshPipeline *pipeline;
+static std::vector<Chunk *> pending;     // dirty, waiting for a free job
+static std::vector<MeshJob *> meshed;
+static int in_flight;       // submitted and not polled yet
+
+void init_world_render(GLuint program) {
+	vPosition = glGetAttribLocation(program, "vPosition");
+	uv = glGetAttribLocation(program, "uv");
+	block_color = glGetAttribLocation(program, "block_color");
+
+	// never deleted: workers are simply stopped with the process
+	pipeline = new MeshPipeline(0, mesh_pool_size);
+
+	// meshes that do not supply per-vertex block colors are drawn untinted
+	glVertexAttrib4f(block_color, 1.0, 1.0, 1.0, 1.0);
+
+	// every chunk shares one index buffer of quads (uploaded through the copy target
+	// so the currently bound vertex array keeps its own element buffer)
+	std::vector<GLuint> indices(MAX_CHUNK_QUADS * 6);
+	for (GLuint q = 0; q < GLuint(MAX_CHUNK_QUADS); q++) {
+		GLuint quad[6] = { 4*q, 4*q + 1, 4*q + 2, 4*q, 4*q + 2, 4*q + 3 };
+		for (int k = 0; k < 6; k++)
+			indices[6*q + k] = quad[k];
+	}
+	glGenBuffers(1, &quad_indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, quad_indices);
+	glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+}
+
+static ChunkMesh &chunk_mesh(ChunkPos pos) {
+	auto it = chunk_meshes.find(pos);
+	if (it != chunk_meshes.end())
+		return it->second;
+
+	ChunkMesh mesh;
+	glGenVertexArrays(1, &mesh.vao);
+	glBindVertexArray(mesh.vao);
+	glGenBuffers(1, &mesh.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_indices);
+
+	glEnableVertexAttribArray(vPosition);
+	glVertexAttribPointer(vPosition, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(BlockVertex), BUFFER_OFFSET(0));
+	glEnableVertexAttribArray(uv);
+	glVertexAttribPointer(uv, 2, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(BlockVertex), BUFFER_OFFSET(4));
+	glEnableVertexAttribArray(block_color);
+	glVertexAttribPointer(block_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BlockVertex), BUFFER_OFFSET(8));
+
+	mesh.index_count = 0;
+	mesh.vertex_bytes = 0;
+	mesh.sequence = 0;
+	mesh.lo = mesh.hi = glm::vec3(0.0f);
+	mesh.solid_lo = mesh.solid_hi = 0;
+	return chunk_meshes[pos] = mesh;
+}
+
+static void upload(const MeshJob &job) {
+	ChunkMesh &mesh = chunk_mesh(job.pos);
+	if (job.sequence < mesh.sequence)
+		return;    // the chunk was edited again and a newer mesh is already resident
+
+	long bytes = long(job.vertices.size() * sizeof(BlockVertex));
+	world_render_stats.quads += long(job.vertices.size() / 4) - mesh.index_count / 6;
+	world_render_stats.vertex_bytes += bytes - mesh.vertex_bytes;
+	mesh.index_count = GLsizei(job.vertices.size() / 4 * 6);
+	mesh.vertex_bytes = bytes;
+	mesh.sequence = job.sequence;
+	mesh.lo = job.bounds_lo;
+	mesh.hi = job.bounds_hi;
+	mesh.solid_lo = job.solid_lo;
+	mesh.solid_hi = job.solid_hi;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, bytes, job.vertices.empty() ? NULL : &job.vertices[0], GL_STATIC_DRAW);
+}
+
+// Upload finished meshes in completion order and return their jobs to the pool. With
+// a budget the first always goes through so a mesh larger than the budget cannot
+// stall the queue.
+static void upload_meshed(bool budget) {
+	typedef std::chrono::duration<double, std::milli> ms;
+	WorldRenderStats &stats = world_render_stats;
+
+	std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+	size_t n = 0;
+	for (; n < meshed.size(); n++) {
+		MeshJob *job = meshed[n];
+		long bytes = long(job->vertices.size() * sizeof(BlockVertex));
+		if (budget && stats.upload_bytes > 0 && stats.upload_bytes + bytes > CHUNK_UPLOAD_BUDGET_BYTES)
+			break;
+		upload(*job);
+		stats.upload_bytes += bytes;
+		stats.chunks_uploaded++;
+		stats.mesh_latency_ms += ms(job->meshed - job->submitted).count();
+		stats.upload_latency_ms += ms(now - job->submitted).count();
+		pipeline->release(job);
+	}
+	meshed.erase(meshed.begin(), meshed.begin() + n);
+}
+
+void update_world_meshes(World &world, bool complete) {
+	WorldRenderStats &stats = world_render_stats;
+
+	stats.chunks_submitted = 0;
+	stats.chunks_uploaded = 0;
+	stats.upload_bytes = 0;
+	stats.mesh_latency_ms = stats.upload_latency_ms = 0.0;
+	world.take_dirty_chunks(pending);
+	for (;;) {
+		// hand pending chunks to the workers while there are free jobs
+		size_t submitted = 0;
+		while (submitted < pending.size() && pipeline->submit(world, pending[submitted]->pos)) {
+			pending[submitted]->dirty = false;
+			submitted++;
+			in_flight++;
+		}
+		pending.erase(pending.begin(), pending.begin() + submitted);
+		stats.chunks_submitted += int(submitted);
+
+		for (MeshJob *job = pipeline->poll(); job != NULL; job = pipeline->poll()) {
+			meshed.push_back(job);
+			in_flight--;
+		}
+		if (!complete)
+			break;
+
+		// until every dirty chunk has been meshed: uploading frees the jobs for the
+		// chunks still pending
+		bool progress = submitted > 0 || !meshed.empty();
+		upload_meshed(false);
+		if (pending.empty() && in_flight == 0)
+			break;
+		if (!progress) {
+			if (in_flight == 0)
+				break;    // nothing left that could free a job; do not spin
+			std::this_thread::yield();
+		}
+	}
+	if (!complete)
+		upload_meshed(true);
+
+	stats.chunks_waiting = int(meshed.size());
+	if (stats.chunks_uploaded > 0) {
+		stats.mesh_latency_ms /= stats.chunks_uploaded;
+		stats.upload_latency_ms /= stats.chunks_uploaded;
+	}
+}
+
+void draw_world(const Affine &block_to_world, bool occlusion) {
+	world_render_stats.chunks_drawn = world_render_stats.chunks_occluded = 0;
+
+	// every solid slab goes in first; buried chunks have no faces but still hide
+	// what is behind them
+	for (auto &entry : chunk_meshes) {
+		const ChunkMesh &chunk = entry.second;
+		if (!occlusion || chunk.solid_hi <= chunk.solid_lo)
+			continue;
+		ChunkPos pos = entry.first;
+		Affine model = block_to_world * affine_translate(pos.x * CHUNK_SIZE, pos.y * CHUNK_SIZE, pos.z * CHUNK_SIZE);
+		occlusion_buffer.add_occluder_box(model, glm::vec3(0, chunk.solid_lo, 0), glm::vec3(CHUNK_SIZE, chunk.solid_hi, CHUNK_SIZE));
+	}
+
+	for (auto &entry : chunk_meshes) {
+		const ChunkMesh &chunk = entry.second;
+		if (chunk.index_count == 0)
+			continue;
+		ChunkPos pos = entry.first;
+		Affine model = block_to_world * affine_translate(pos.x * CHUNK_SIZE, pos.y * CHUNK_SIZE, pos.z * CHUNK_SIZE);
+
+		// world space box of the mesh, tighter than the chunk for surface chunks
+		glm::vec3 lo(1e30f), hi(-1e30f);
+		for (int i = 0; i < 8; i++) {
+			glm::vec3 p = model.transform_point(glm::vec3((i & 1) ? chunk.hi.x : chunk.lo.x, (i & 2) ? chunk.hi.y : chunk.lo.y, (i & 4) ? chunk.hi.z : chunk.lo.z));
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+		}
+		if (occlusion && !occlusion_buffer.test_box(lo, hi)) {
+			world_render_stats.chunks_occluded++;
+			continue;
+		}
+
+		glm::vec4 bounds(0.5f * (chunk.lo + chunk.hi), 0.5f * glm::length(chunk.hi - chunk.lo));
+		Mesh mesh = { chunk.vao, 0, chunk.index_count, bounds };
+		submit_tested_draw(mesh, model, glm::vec4(1.0), 1);
+		world_render_stats.chunks_drawn++;
+	}
+}
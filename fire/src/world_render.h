@@ -0,0 +1,47 @@
+// GPU side of the block world: one vertex buffer per chunk, drawn with the textured
+// block shader through the batched draw path (one draw call per non-empty chunk).
+// Dirty chunks are meshed on worker threads (see mesh_pipeline.h) and uploaded on
+// the GL thread within a per-frame byte budget. Chunks hidden behind the solid
+// layers of other chunks are skipped (see occlusion.h).
+
+#ifndef WORLD_RENDER_H
+#define WORLD_RENDER_H
+
+#include "common.h"
+#include "affine.h"
+#include "chunk.h"
+
+// Per-frame upload budget for chunk vertex data
+const long CHUNK_UPLOAD_BUDGET_BYTES = 1024 * 1024;
+
+struct WorldRenderStats {
+	// this frame
+	int chunks_submitted;    // handed to the meshing workers
+	int chunks_uploaded;
+	long upload_bytes;
+	double mesh_latency_ms;  // average submit -> meshed of the uploaded chunks
+	double upload_latency_ms;// average submit -> uploaded of the uploaded chunks
+	int chunks_waiting;      // meshed but held back by the upload budget
+	int chunks_occluded;     // hidden behind the solid parts of other chunks
+	int chunks_drawn;
+
+	// resident in all chunk buffers
+	long quads;
+	long vertex_bytes;
+};
+
+extern WorldRenderStats world_render_stats;
+
+extern void init_world_render(GLuint program);
+
+// Queue dirty chunks for meshing and upload finished meshes. complete waits for
+// every dirty chunk and uploads it this frame, so what is drawn does not depend on
+// the workers' timing (offline rendering).
+extern void update_world_meshes(World &world, bool complete = false);
+
+// Add the solid part of every chunk to occlusion_buffer, then queue one draw per
+// non-empty chunk that is not hidden; block_to_world maps block units to the scene.
+// Without occlusion every non-empty chunk is queued and nothing is added.
+extern void draw_world(const Affine &block_to_world, bool occlusion = true);
+
+#endif // WORLD_RENDER_H
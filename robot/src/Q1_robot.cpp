@@ -1,11 +1,25 @@
 // Display a cube, using glDrawElements
 
 #include "common.h"
+#include "uniforms.h"
+#include "frustum.h"
+#include "occlusion.h"
+#include "impostor.h"
+#include "startup_trace.h"
+#include "frame_stats.h"
+#include "hud.h"
+#include "telemetry.h"
+#include "frame_capture.h"
+#include "flight_recorder.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
 #include <vector>
 
 const char *WINDOW_TITLE = "Running Robot";
@@ -17,10 +31,23 @@ typedef glm::vec4  point4;
 std::vector<glm::vec4> icosphere_vertices;
 std::vector<GLuint> icosphere_indices;
 
-long long ms;
 GLfloat the_time;
 
 GLuint cube_vao, sphere_vao, square_vao, pyramid_vao;
+Mesh cube_mesh, square_mesh, pyramid_mesh;
+
+// Icosphere subdivision levels 0-4, all in sphere_vao; draw_icosphere() picks one by
+// the sphere's radius on screen
+const int SPHERE_LODS = 5;
+const float sphere_lod_pixels[SPHERE_LODS - 1] = { 4.0, 12.0, 32.0, 80.0 };   // radius where each next level starts
+Mesh sphere_lods[SPHERE_LODS];
+int sphere_lod_draws[SPHERE_LODS];   // this frame
+int sphere_lod_override = -1;        // fixed level while baking impostors
+const int sphere_baseline_lod = 1;   // the one level drawn before LOD, with --baseline
+
+// Projected size: pixels per unit of size at unit distance, and the eye in world space
+float lod_pixels_per_unit = 1.0;
+glm::vec3 camera_position;
 
 point4 cube_vertices[8] = {
    point4(-0.5, -0.5,  0.5, 1.0),
@@ -81,108 +108,77 @@ float distance_count = 0.0;
 float floor_distance = 0.0;
 float floor_scale = 50.0;
 
-GLuint  ModelView, Projection, ColorLocation, IsFloorLocation, TimeLocation;
-color4 Color;
-
-glm::mat4 eps_scale;
-
+FrameUniforms frame_uniforms;
 
-glm::mat4 gen_rotate(GLfloat rot_x, GLfloat rot_y, GLfloat rot_z) {
-	glm::mat4 rotate;
+Affine eps_scale;
 
-	rotate = glm::rotate(rotate, glm::radians(rot_x), glm::vec3(1, 0, 0));
-	rotate = glm::rotate(rotate, glm::radians(rot_y), glm::vec3(0, 1, 0));
-	rotate = glm::rotate(rotate, glm::radians(rot_z), glm::vec3(0, 0, 1));
 
-	return rotate;
+Affine gen_rotate(GLfloat rot_x, GLfloat rot_y, GLfloat rot_z) {
+	return affine_rotate(rot_x, rot_y, rot_z);
 }
 
-glm::mat4 gen_trans(float x, float y, float z) {
-	glm::mat4 trans;
-	return glm::translate(trans, glm::vec3(x, y, z));
+Affine gen_trans(float x, float y, float z) {
+	return affine_translate(x, y, z);
 }
 
-glm::mat4 gen_scale(float x, float y, float z) {
-	glm::mat4 scale;
-	return glm::scale(scale, glm::vec3(x, y, z));
+Affine gen_scale(float x, float y, float z) {
+	return affine_scale(x, y, z);
 }
 
-void draw_icosphere(glm::mat4 model_view) {
-	glBindVertexArray(sphere_vao);
-
-	// draw icosphere
-	glUniform4fv(ColorLocation, 1, glm::value_ptr(color4(0.0, 0.0, 0.0, 1.0)));
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view));
-	for (int i = 0; i < icosphere_indices.size(); i += 3)
-		glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
+// Coverage of the robot parts being queued; below 1 they are dithered out, which
+// crossfades a robot into its impostor
+float part_alpha = 1.0;
+
+int sphere_lod(const Affine &model) {
+	if (sphere_lod_override >= 0)
+		return sphere_lod_override;
+	if (BaselineRendering())
+		return sphere_baseline_lod;
+	float scale2 = 0.0;
+	for (int j = 0; j < 3; j++)
+		scale2 = std::max(scale2, model.rows[0][j]*model.rows[0][j] + model.rows[1][j]*model.rows[1][j] + model.rows[2][j]*model.rows[2][j]);
+	float distance = std::max(glm::length(model.translation() - camera_position), 0.01f);
+	float pixels = std::sqrt(scale2) * lod_pixels_per_unit / distance;
+	int level = 0;
+	while (level < SPHERE_LODS - 1 && pixels >= sphere_lod_pixels[level])
+		level++;
+	return level;
+}
 
-	// draw outline
-	glUniform4fv(ColorLocation, 1, glm::value_ptr(color4(0.5, 0.5, 0.5, 1.0)));
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view*eps_scale));
-	for (int i = 0; i < icosphere_indices.size(); i += 3)
-		glDrawElements(GL_LINE_LOOP, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
+void draw_icosphere(const Affine &model) {
+	int level = sphere_lod(model);
+	sphere_lod_draws[level]++;
+	submit_draw(sphere_lods[level], model, color4(0.0, 0.0, 0.0, part_alpha));
+	submit_draw(sphere_lods[level], model*eps_scale, color4(0.5, 0.5, 0.5, part_alpha), 0, true);
 }
 
 color4 default_color = color4(0.5, 0.5, 0.5, 1.0);
-void draw_cube(glm::mat4 model_view, color4 color=default_color) {
-	glBindVertexArray(cube_vao);
-
-	// draw cube
-	glUniform4fv(ColorLocation, 1, glm::value_ptr(color));
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view));
-	for (int i = 0; i < sizeof(cube_indices) / sizeof(GLuint); i += 3)
-		glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
-
-	// draw outline
-	glUniform4fv(ColorLocation, 1, glm::value_ptr(color4(0.0, 0.0, 0.0, 1.0)));
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view*eps_scale));
-	for (int i = 0; i < sizeof(cube_indices) / sizeof(GLuint); i += 3)
-		glDrawElements(GL_LINE_LOOP, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
+void draw_cube(const Affine &model, color4 color=default_color) {
+	color.a = part_alpha;
+	submit_draw(cube_mesh, model, color);
+	submit_draw(cube_mesh, model*eps_scale, color4(0.0, 0.0, 0.0, part_alpha), 0, true);
 }
 
-void draw_floor(glm::mat4 model_view, color4 color = color4(0.5, 0.5, 0.5, 1.0)) {
-	glBindVertexArray(square_vao);
-	glUniform1i(IsFloorLocation, 1);
-
-	glUniform1f(TimeLocation, the_time);
-
-	// draw square
-	glUniform4fv(ColorLocation, 1, glm::value_ptr(color));
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view));
-	for (int i = 0; i < sizeof(square_indices) / sizeof(GLuint); i += 3)
-		glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
-
-	glUniform1i(IsFloorLocation, 0);
+void draw_floor(const Affine &model, color4 color = color4(0.5, 0.5, 0.5, 1.0)) {
+	submit_draw(square_mesh, model, color, 1);
 }
 
-void draw_pyramid(glm::mat4 model_view) {
-	glBindVertexArray(pyramid_vao);
-
-	// draw pyramid
-	glUniform4fv(ColorLocation, 1, glm::value_ptr(color4(0.8, 0.2, 0.2, 1.0)));
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view));
-	for (int i = 0; i < sizeof(pyramid_vertices) / sizeof(GLuint); i += 3)
-		glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
-
-	// draw outline
-	glUniform4fv(ColorLocation, 1, glm::value_ptr(color4(0.0, 0.0, 0.0, 1.0)));
-	glUniformMatrix4fv(ModelView, 1, GL_FALSE, glm::value_ptr(model_view*eps_scale));
-	for (int i = 0; i < sizeof(pyramid_vertices) / sizeof(GLuint); i += 3)
-		glDrawElements(GL_LINE_LOOP, 3, GL_UNSIGNED_INT, (void *)(i * sizeof(GLuint)));
+void draw_pyramid(const Affine &model) {
+	submit_draw(pyramid_mesh, model, color4(0.8, 0.2, 0.2, part_alpha));
+	submit_draw(pyramid_mesh, model*eps_scale, color4(0.0, 0.0, 0.0, part_alpha), 0, true);
 }
 
-void draw_arm(glm::mat4 model_view, float elbow_deg, float shoulder_deg, bool do_end=true) {
-	glm::mat4 elbow_joint_rot, shoulder_joint_rot;
-	elbow_joint_rot = glm::rotate(elbow_joint_rot, glm::radians((GLfloat) elbow_deg), glm::vec3(0, 0, 1));
-	shoulder_joint_rot = glm::rotate(shoulder_joint_rot, glm::radians((GLfloat) shoulder_deg), glm::vec3(0, 0, 1));
+void draw_arm(const Affine &model, float elbow_deg, float shoulder_deg, bool do_end=true) {
+	Affine shoulder = model * gen_rotate(0.0, 0.0, shoulder_deg);
+	Affine elbow = shoulder * gen_trans(0.0, -2.0, 0.0) * gen_rotate(0.0, 0.0, elbow_deg);
 
-	draw_cube(model_view * shoulder_joint_rot * gen_trans(0.0, -1.0, 0.0) * gen_scale(1.0, 2.0, 1.0));
-	draw_cube(model_view * shoulder_joint_rot * gen_trans(0.0, -2.0, 0.0) * elbow_joint_rot * gen_trans(0.0, -1.0, 0.0) * gen_scale(1.0, 2.0, 1.0));
-	draw_icosphere(model_view * shoulder_joint_rot * gen_trans(0.0, -2.0, 0.0) * elbow_joint_rot * gen_scale(0.75, 0.75, 0.75));
+	draw_cube(shoulder * affine_trs(glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0), glm::vec3(1.0, 2.0, 1.0)));
+	draw_cube(elbow * affine_trs(glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0), glm::vec3(1.0, 2.0, 1.0)));
+	draw_icosphere(elbow * gen_scale(0.75, 0.75, 0.75));
 
-	draw_pyramid(model_view * shoulder_joint_rot * gen_trans(0.0, -2.0, 0.0) * elbow_joint_rot * gen_trans(0.0, -2.0, 0.0));
+	draw_pyramid(elbow * gen_trans(0.0, -2.0, 0.0));
 	if (do_end)
-		draw_pyramid(model_view * shoulder_joint_rot * gen_trans(0.0, -2.0, 0.0) * elbow_joint_rot * gen_trans(0.0, -2.4, 0.0) * gen_rotate(180.0, 0.0, 0.0));
+		draw_pyramid(elbow * affine_trs(glm::vec3(0.0, -2.4, 0.0), glm::vec3(180.0, 0.0, 0.0), glm::vec3(1.0)));
 }
 
 // Generate an icosphere
@@ -271,99 +267,371 @@ void setup_buffers(GLuint &vao, int vertices_size, GLvoid *vertices, int indices
 	
 }
 
-// OpenGL initialization
-void init()
-{
-	icosphere(1, icosphere_vertices, icosphere_indices);
-	eps_scale = glm::scale(eps_scale, glm::vec3(1.001, 1.001, 1.001));
+float wave(float min, float max, float x) {
+	return 0.5*(max - min)*(sin(x) + 1.0) + min;
+}
 
-	GLuint program = InitShader("vshader6.glsl", "fshader5.glsl");
-	
-	setup_buffers(cube_vao, sizeof(cube_vertices), cube_vertices, sizeof(cube_indices), cube_indices, program);
-	setup_buffers(sphere_vao, sizeof(glm::vec4)*icosphere_vertices.size(), &icosphere_vertices[0], sizeof(GLuint)*icosphere_indices.size(), &icosphere_indices[0], program);
-	setup_buffers(square_vao, sizeof(square_vertices), square_vertices, sizeof(square_indices), square_indices, program);
-	setup_buffers(pyramid_vao, sizeof(pyramid_vertices), pyramid_vertices, sizeof(pyramid_indices), pyramid_indices, program);
 
-	ModelView = glGetUniformLocation(program, "ModelView");
-	Projection = glGetUniformLocation(program, "Projection");
-	ColorLocation = glGetUniformLocation(program, "SetColor");
 
-	IsFloorLocation = glGetUniformLocation(program, "IsFloorInput");
-	glUniform1i(IsFloorLocation, 0);
+// Joint angles (degrees) and body bob of a robot; plain floats so the flight
+// recorder can store them as they are
+struct RobotPose {
+	float left_shoulder_deg, left_elbow_deg;
+	float right_shoulder_deg, right_elbow_deg;
+	float left_knee_deg, right_knee_deg;
+	float bob;
+};
+const int ROBOT_POSE_FLOATS = sizeof(RobotPose) / sizeof(float);
+
+// scaled_time is the run cycle angle, repeating every 2 pi
+RobotPose robot_pose(float scaled_time) {
+	RobotPose pose;
+	pose.left_shoulder_deg = wave(-45.0, 45.0, scaled_time);
+	pose.left_elbow_deg = wave(30.0, 90.0, scaled_time);
+	pose.right_shoulder_deg = -wave(-45.0, 45.0, scaled_time);
+	pose.right_elbow_deg = 90.0 - wave(0.0, 40.0, scaled_time);
+	pose.left_knee_deg = -wave(0.0, 80.0, scaled_time);
+	pose.right_knee_deg = -wave(0.0, 80.0, -scaled_time);
+	pose.bob = 0.04*(sin(2*scaled_time)+0.8);
+	return pose;
+}
+
+// Places one running robot
+void draw_robot(const Affine &placement, const RobotPose &pose) {
+	float left_shoulder_deg = pose.left_shoulder_deg, left_elbow_deg = pose.left_elbow_deg;
+	float right_shoulder_deg = pose.right_shoulder_deg, right_elbow_deg = pose.right_elbow_deg;
+	float left_knee_deg = pose.left_knee_deg, right_knee_deg = pose.right_knee_deg;
+
+	// robot (the bob and the extra yaw commute with the camera's y-axis rotation)
+	Affine model = placement * gen_trans(0.0, 0.63 + pose.bob, 0.0) * gen_rotate(0.0, 90.0, 0.0) * gen_scale(0.1, 0.1, 0.1) * gen_scale(0.8, 0.8, 0.8);
 
-	TimeLocation = glGetUniformLocation(program, "SetTime");
+	// arms
+	draw_arm(model * gen_trans(-2.0, 0.0, 0.0) * gen_rotate(0.0, -90.0, 0.0), left_elbow_deg, left_shoulder_deg);
+	draw_icosphere(model * affine_trs(glm::vec3(-1.0, 0.0, 0.0), glm::vec3(-left_shoulder_deg, 0.0, 0.0), glm::vec3(1.5, 0.5, 0.5)));
+	draw_icosphere(model * affine_trs(glm::vec3(-2.0, 0.0, 0.0), glm::vec3(-left_shoulder_deg, 0.0, 0.0), glm::vec3(0.6)));
 
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(1.0, 1.0, 1.0, 1.0);
-}
+	draw_arm(model * gen_trans(2.0, 0.0, 0.0) * gen_rotate(0.0, -90.0, 0.0), right_elbow_deg, right_shoulder_deg);
+	draw_icosphere(model * affine_trs(glm::vec3(1.0, 0.0, 0.0), glm::vec3(-right_shoulder_deg, 0.0, 0.0), glm::vec3(1.5, 0.5, 0.5)));
+	draw_icosphere(model * affine_trs(glm::vec3(2.0, 0.0, 0.0), glm::vec3(-right_shoulder_deg, 0.0, 0.0), glm::vec3(0.6)));
 
+	// body
+	draw_cube(model * affine_trs(glm::vec3(0.0, -1.5, 0.0), glm::vec3(0.0), glm::vec3(2.1, 4.0, 1.5)), color4(0.3, 0.3, 0.3, 1.0));
 
+	// left leg
+	draw_arm(model * gen_trans(-0.8, -3.5, 0.0) * gen_rotate(0.0, -90.0, 0.0), left_knee_deg, right_shoulder_deg, false);
+	draw_icosphere(model * affine_trs(glm::vec3(-0.8, -3.5, 0.0), glm::vec3(-right_shoulder_deg, 0.0, 0.0), glm::vec3(0.7)));
 
-float wave(float min, float max, float x) {
-	return 0.5*(max - min)*(sin(x) + 1.0) + min;
+	// right leg
+	draw_arm(model * gen_trans(0.8, -3.5, 0.0) * gen_rotate(0.0, -90.0, 0.0), right_knee_deg, left_shoulder_deg, false);
+	draw_icosphere(model * affine_trs(glm::vec3(0.8, -3.5, 0.0), glm::vec3(-left_shoulder_deg, 0.0, 0.0), glm::vec3(0.7)));
+
+	// head
+	draw_icosphere(model * affine_trs(glm::vec3(0.0, 0.75, 0.0), glm::vec3(0.0), glm::vec3(0.4)));
+	draw_cube(model * affine_trs(glm::vec3(0.0, 1.25, 0.0), glm::vec3(0.0), glm::vec3(1.2)));
 }
 
+void draw_robot(const Affine &placement, float scaled_time) {
+	draw_robot(placement, robot_pose(scaled_time));
+}
 
+// Robot at the origin of placement, in scene units: the part of the torso that is
+// solid throughout the bob (used as an occluder) and a box around every limb over
+// the whole run cycle
+const glm::vec3 robot_torso_lo(-0.06, 0.43, -0.084), robot_torso_hi(0.06, 0.66, 0.084);
+const glm::vec3 robot_bounds_lo(-0.4, -0.05, -0.4), robot_bounds_hi(0.4, 0.9, 0.4);
+
+// Distant robots are drawn as billboards from a baked atlas ('i' toggles, none with
+// --baseline); in between the two distances the full robot and its impostor are
+// crossfaded
+ImpostorAtlas robot_impostors;
+const glm::vec3 robot_impostor_center(0.0, 0.425, 0.0);
+const float robot_impostor_half_size = 0.475;
+const float impostor_near = 1.5;
+const float impostor_far = 2.0;
+bool use_impostors = true;
+
+// Crowd mode ('c'): a grid of robots, the nearer ones hiding the farther ones
+const int crowd_side = 16;
+const float crowd_spacing = 0.6;
+bool crowd_mode = false;
+
+struct CrowdStats {
+	int robots;
+	int culled;            // outside the frustum
+	int occluded;
+	int full;              // drawn part by part
+	int crossfading;
+	int impostors;
+};
 
-void display( void )
-{
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+CrowdStats crowd_stats;
+
+// 'm' measures how many robots fit in 16 ms: budget_frames frames with every robot
+// drawn in full, then as many with every robot as an impostor, each frame waiting
+// for the GPU to finish
+enum BudgetPass { BUDGET_OFF, BUDGET_FULL, BUDGET_IMPOSTORS };
+const int budget_frames = 60;
+BudgetPass budget_pass = BUDGET_OFF;
+int budget_frame;
+double budget_ms;
+long budget_robots;
+
+// This frame's run cycle and pose of every robot (one outside crowd mode), from the
+// clock or from a flight recording
+std::vector<float> robot_cycles;
+std::vector<RobotPose> robot_poses;
+
+// Flight recorder channels (see flight_recorder.h); ids in the recording when
+// replaying, else in flight_recorder
+struct FlightChannels {
+	int theta, crowd, robot_cycle, robot_joints;
+};
+FlightChannels flight_channels;
+
+void init_flight_channels() {
+	if (flight_playback.active()) {
+		flight_channels.theta = flight_playback.channel("camera.theta");
+		flight_channels.crowd = flight_playback.channel("scene.crowd");
+		flight_channels.robot_cycle = flight_playback.channel("robot.cycle");
+		flight_channels.robot_joints = flight_playback.channel("robot.joints");
+	} else {
+		flight_channels.theta = flight_recorder.add_channel("camera.theta", 0.01f);
+		flight_channels.crowd = flight_recorder.add_channel("scene.crowd", 1.0f);
+		flight_channels.robot_cycle = flight_recorder.add_channel("robot.cycle", 1e-4f);
+		flight_channels.robot_joints = flight_recorder.add_channel("robot.joints", 0.01f);
+	}
+}
 
-	glm::mat4 view_trans, rot, scale, model_view;
-	rot = gen_rotate(0.0, Theta[Yaxis], 0.0);
+// Fills robot_cycles and robot_poses, and the camera and mode when replaying
+void pose_robots() {
+	size_t robots = crowd_mode ? crowd_side*crowd_side : 1;
+	const FlightChannels &c = flight_channels;
+	if (flight_playback.active() && c.theta >= 0 && c.crowd >= 0 && c.robot_cycle >= 0 && c.robot_joints >= 0) {
+		const std::vector<float> &theta = flight_playback.values(c.theta), &crowd = flight_playback.values(c.crowd);
+		if (theta.size() == NumAxes)
+			std::copy(theta.begin(), theta.end(), Theta);
+		if (crowd.size() == 1)
+			crowd_mode = crowd[0] != 0.0;
+		robots = crowd_mode ? crowd_side*crowd_side : 1;
+		const std::vector<float> &cycles = flight_playback.values(c.robot_cycle), &joints = flight_playback.values(c.robot_joints);
+		if (cycles.size() == robots && joints.size() == robots*ROBOT_POSE_FLOATS) {
+			robot_cycles = cycles;
+			robot_poses.resize(robots);
+			memcpy(&robot_poses[0], &joints[0], joints.size() * sizeof(float));
+			return;
+		}
+	}
 
-	const glm::vec3 viewer_pos( 0.0, 0.5, 1.8 );
-	view_trans = glm::translate(view_trans, -viewer_pos);
+	robot_cycles.resize(robots);
+	robot_poses.resize(robots);
+	for (size_t k = 0; k < robots; k++) {
+		robot_cycles[k] = the_time*6.0 + (crowd_mode ? 0.7*k : 0.0);
+		robot_poses[k] = robot_pose(robot_cycles[k]);
+	}
+}
 
-	scale = gen_scale(0.1, 0.1, 0.1);
+void record_flight_frame() {
+	float crowd = crowd_mode ? 1.0 : 0.0;
+	flight_recorder.record(flight_channels.theta, Theta, NumAxes);
+	flight_recorder.record(flight_channels.crowd, &crowd, 1);
+	flight_recorder.record(flight_channels.robot_cycle, &robot_cycles[0], robot_cycles.size());
+	flight_recorder.record(flight_channels.robot_joints, (const float *)&robot_poses[0], robot_poses.size() * ROBOT_POSE_FLOATS);
+}
 
+void draw_crowd(const glm::mat4 &view_projection, const glm::vec3 &camera) {
+	std::vector<Affine> placements;
+	for (int i = 0; i < crowd_side; i++)
+		for (int j = 0; j < crowd_side; j++)
+			placements.push_back(gen_trans((i - 0.5*(crowd_side - 1))*crowd_spacing, 0.0, (j - 0.5*(crowd_side - 1))*crowd_spacing));
+
+	// torsos first, so every robot is tested against all of them; the baseline tests nothing
+	bool cull = !BaselineRendering();
+	for (size_t k = 0; cull && k < placements.size(); k++)
+		occlusion_buffer.add_occluder_box(placements[k], robot_torso_lo, robot_torso_hi);
+
+	Frustum frustum = frustum_from_matrix(view_projection);
+	crowd_stats = CrowdStats();
+	crowd_stats.robots = int(placements.size());
+	for (size_t k = 0; k < placements.size(); k++) {
+		glm::vec3 lo = placements[k].transform_point(robot_bounds_lo), hi = placements[k].transform_point(robot_bounds_hi);
+		if (cull && !frustum_test_sphere(frustum, 0.5f*(lo + hi), 0.5f*glm::length(hi - lo))) {
+			crowd_stats.culled++;
+			continue;
+		}
+		if (cull && !occlusion_buffer.test_box(lo, hi)) {
+			crowd_stats.occluded++;
+			continue;
+		}
 
-	// floor
-	draw_floor(view_trans * rot * gen_rotate(90.0, 0.0, 0.0) * gen_scale(4.0, 4.0, 4.0));
+		// placements are translations, so the direction to the camera needs no turning
+		float cycle = robot_cycles[k];
+		glm::vec3 position = placements[k].translation();
+		glm::vec3 to_camera = camera - (position + robot_impostor_center);
+		float distance = glm::length(to_camera);
+		float fade = glm::clamp((distance - impostor_near) / (impostor_far - impostor_near), 0.0f, 1.0f);
+		if (!use_impostors || !robot_impostors.baked() || budget_pass == BUDGET_FULL)
+			fade = 0.0;
+		else if (budget_pass == BUDGET_IMPOSTORS)
+			fade = 1.0;
+
+		if (fade < 1.0) {
+			part_alpha = 1.0 - fade;
+			draw_robot(placements[k], robot_poses[k]);
+			part_alpha = 1.0;
+		}
+		if (fade > 0.0)
+			submit_draw(square_mesh, robot_impostors.billboard(position, to_camera), color4(1.0, 1.0, 1.0, fade),
+			            impostor_flags(robot_impostors.cell(cycle, to_camera)));
+
+		if (fade == 0.0)
+			crowd_stats.full++;
+		else if (fade == 1.0)
+			crowd_stats.impostors++;
+		else
+			crowd_stats.crossfading++;
+	}
+}
 
+// OpenGL initialization
+void init()
+{
+	// the driver compiles while the sphere levels are generated
+	GLuint program = BeginShader("vshader6.glsl", "fshader5.glsl");
+
+	init_flight_channels();
+
+	// the levels back to back; indices are offset to their level's first vertex
+	startup_trace_begin("icospheres");
+	GLsizei sphere_first[SPHERE_LODS], sphere_count[SPHERE_LODS];
+	for (int level = 0; level < SPHERE_LODS; level++) {
+		std::vector<glm::vec4> vertices;
+		std::vector<GLuint> indices;
+		icosphere(level, vertices, indices);
+		GLuint base = GLuint(icosphere_vertices.size());
+		sphere_first[level] = GLsizei(icosphere_indices.size());
+		sphere_count[level] = GLsizei(indices.size());
+		icosphere_vertices.insert(icosphere_vertices.end(), vertices.begin(), vertices.end());
+		for (GLuint index : indices)
+			icosphere_indices.push_back(base + index);
+	}
+	eps_scale = gen_scale(1.001, 1.001, 1.001);
+	startup_trace_end();
 
-	float scaled_time = the_time*6.0;
+	FinishShader(program);
+	
+	startup_trace_begin("vertex buffers");
+	setup_buffers(cube_vao, sizeof(cube_vertices), cube_vertices, sizeof(cube_indices), cube_indices, program);
+	setup_buffers(sphere_vao, sizeof(glm::vec4)*icosphere_vertices.size(), &icosphere_vertices[0], sizeof(GLuint)*icosphere_indices.size(), &icosphere_indices[0], program);
+	setup_buffers(square_vao, sizeof(square_vertices), square_vertices, sizeof(square_indices), square_indices, program);
+	setup_buffers(pyramid_vao, sizeof(pyramid_vertices), pyramid_vertices, sizeof(pyramid_indices), pyramid_indices, program);
 
-	float left_shoulder_deg, left_elbow_deg;
-	left_shoulder_deg = wave(-45.0, 45.0, scaled_time);
-	left_elbow_deg = wave(30.0, 90.0, scaled_time);
+	// bounding spheres: the cube and pyramid span [-0.5, 0.5]^3, the square [-0.5, 0.5]^2
+	cube_mesh = { cube_vao, 0, sizeof(cube_indices) / sizeof(GLuint), glm::vec4(0.0, 0.0, 0.0, 0.87) };
+	for (int level = 0; level < SPHERE_LODS; level++)
+		sphere_lods[level] = { sphere_vao, sphere_first[level], sphere_count[level], glm::vec4(0.0, 0.0, 0.0, 1.0) };
+	square_mesh = { square_vao, 0, sizeof(square_indices) / sizeof(GLuint), glm::vec4(0.0, 0.0, 0.0, 0.71) };
+	pyramid_mesh = { pyramid_vao, 0, sizeof(pyramid_indices) / sizeof(GLuint), glm::vec4(0.0, 0.0, 0.0, 0.87) };
 
-	float right_shoulder_deg, right_elbow_deg;
-	right_shoulder_deg = -wave(-45.0, 45.0, scaled_time);
-	right_elbow_deg = 90.0 - wave(0.0, 40.0, scaled_time);
+	init_uniform_blocks(program);
+	startup_trace_end();
 
-	float left_knee_deg, right_knee_deg;
-	left_knee_deg = -wave(0.0, 80.0, scaled_time);
-	right_knee_deg = -wave(0.0, 80.0, -scaled_time);
+	glEnable(GL_DEPTH_TEST);
+	glUniform1i(glGetUniformLocation(program, "atlas"), IMPOSTOR_TEXTURE_UNIT);
+	// the baseline draws every robot in full, so it needs no atlas
+	if (!BaselineRendering()) {
+		StartupPhase bake("impostor atlas");
+		sphere_lod_override = 2;
+		robot_impostors.bake(robot_impostor_center, robot_impostor_half_size, [](float cycle) { draw_robot(Affine(), cycle); });
+		sphere_lod_override = -1;
+	}
 
-	// robot
-	model_view = gen_trans(0.0, 0.63 + 0.04*(sin(2*scaled_time)+0.8), 0.0) * view_trans * gen_rotate(0.0, 90.0, 0.0) * rot * scale * gen_scale(0.8, 0.8, 0.8);
+	glClearColor(1.0, 1.0, 1.0, 1.0);
+}
 
-	// arms
-	draw_arm(model_view * gen_trans(-2.0, 0.0, 0.0) * gen_rotate(0.0, -90.0, 0.0), left_elbow_deg, left_shoulder_deg);
-	draw_icosphere(model_view * gen_trans(-1.0, 0.0, 0.0) * gen_rotate(-left_shoulder_deg, 0.0, 0.0) * gen_scale(1.5, 0.5, 0.5));
-	draw_icosphere(model_view * gen_trans(-2.0, 0.0, 0.0) * gen_rotate(-left_shoulder_deg, 0.0, 0.0) * gen_scale(0.6, 0.6, 0.6));
+// Advances the 'm' measurement after a frame of frame_ms with robots drawn
+void record_budget_frame(double frame_ms, int robots) {
+	budget_ms += frame_ms;
+	budget_robots += robots;
+	if (++budget_frame < budget_frames)
+		return;
+	double per_16ms = budget_ms > 0.0 ? 16.0 * budget_robots / budget_ms : 0.0;
+	std::cout << (budget_pass == BUDGET_FULL ? "full robots: " : "impostors: ") << per_16ms << " per 16 ms ("
+	          << double(budget_robots) / budget_frames << " drawn in " << budget_ms / budget_frames << " ms per frame)" << std::endl;
+	budget_pass = budget_pass == BUDGET_FULL ? BUDGET_IMPOSTORS : BUDGET_OFF;
+	budget_frame = 0;
+	budget_ms = 0.0;
+	budget_robots = 0;
+}
+
+void display( void )
+{
+	std::chrono::high_resolution_clock::time_point frame_start = std::chrono::high_resolution_clock::now();
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-	draw_arm(model_view * gen_trans(2.0, 0.0, 0.0) * gen_rotate(0.0, -90.0, 0.0), right_elbow_deg, right_shoulder_deg);
-	draw_icosphere(model_view * gen_trans(1.0, 0.0, 0.0) * gen_rotate(-right_shoulder_deg, 0.0, 0.0) * gen_scale(1.5, 0.5, 0.5));
-	draw_icosphere(model_view * gen_trans(2.0, 0.0, 0.0) * gen_rotate(-right_shoulder_deg, 0.0, 0.0) * gen_scale(0.6, 0.6, 0.6));
+	if (flight_playback.active())
+		the_time = flight_playback.time();
+	pose_robots();
+	if (flight_recorder.active())
+		record_flight_frame();
 
-	// body
-	draw_cube(model_view * gen_trans(0.0, -1.5, 0.0) * gen_scale(2.1, 4.0, 1.5), color4(0.3, 0.3, 0.3, 1.0));
+	Affine view;
 
-	// left leg
-	draw_arm(model_view * gen_trans(-0.8, -3.5, 0.0) * gen_rotate(0.0, -90.0, 0.0), left_knee_deg, right_shoulder_deg, false);
-	draw_icosphere(model_view * gen_trans(-0.8, -3.5, 0.0) * gen_rotate(-right_shoulder_deg, 0.0, 0.0) * gen_scale(0.7, 0.7, 0.7));
+	const glm::vec3 viewer_pos( 0.0, 0.5, 1.8 );
+	view = gen_trans(-viewer_pos[0], -viewer_pos[1], -viewer_pos[2]) * gen_rotate(0.0, Theta[Yaxis], 0.0);
 
-	// right leg
-	draw_arm(model_view * gen_trans(0.8, -3.5, 0.0) * gen_rotate(0.0, -90.0, 0.0), right_knee_deg, left_shoulder_deg, false);
-	draw_icosphere(model_view * gen_trans(0.8, -3.5, 0.0) * gen_rotate(-left_shoulder_deg, 0.0, 0.0) * gen_scale(0.7, 0.7, 0.7));
+	frame_uniforms.view = view.to_mat4();
+	frame_uniforms.time = glm::vec4(the_time, 0.0, 0.0, 0.0);
+	set_frame_uniforms(frame_uniforms);
+	camera_position = glm::vec3(glm::inverse(frame_uniforms.view)[3]);
+	std::fill(sphere_lod_draws, sphere_lod_draws + SPHERE_LODS, 0);
 
-	// head
-	draw_icosphere(model_view * gen_trans(0.0, 0.75, 0.0) * gen_scale(0.4, 0.4, 0.4));
-	draw_cube(model_view * gen_trans(0.0, 1.25, 0.0) * gen_scale(1.2, 1.2, 1.2));
+	// floor
+	float floor_size = crowd_mode ? crowd_side*crowd_spacing + 1.0 : 4.0;
+	draw_floor(gen_rotate(90.0, 0.0, 0.0) * gen_scale(floor_size, floor_size, floor_size));
+
+	if (crowd_mode)
+		draw_crowd(frame_uniforms.projection * frame_uniforms.view, camera_position);
+	else
+		draw_robot(Affine(), robot_poses[0]);
+
+	flush_draws(!BaselineRendering());
+	frame_stats.add_submit_ms(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frame_start).count());
+	if (budget_pass != BUDGET_OFF) {
+		glFinish();
+		record_budget_frame(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frame_start).count(),
+		                    crowd_stats.full + crowd_stats.crossfading + crowd_stats.impostors);
+	}
+#ifdef DEBUG
+	static int frame_count = 0;
+	if (++frame_count % 120 == 0) {
+		std::cout << "culling: " << cull_stats.tested << " tested, " << cull_stats.culled << " culled, "
+		          << cull_stats.occluded << " occluded, " << cull_stats.drawn << " drawn" << std::endl;
+		std::cout << "sphere lods:";
+		for (int level = 0; level < SPHERE_LODS; level++)
+			std::cout << " " << sphere_lod_draws[level];
+		std::cout << std::endl;
+		if (crowd_mode)
+			std::cout << "crowd: " << crowd_stats.robots << " robots, " << crowd_stats.culled << " culled, "
+			          << crowd_stats.occluded << " occluded, " << occlusion_buffer.stats().raster_ms << " ms rasterizing; "
+			          << crowd_stats.full << " full, " << crowd_stats.crossfading << " crossfading, "
+			          << crowd_stats.impostors << " impostors" << std::endl;
+	}
+#endif
+
+	if (hud.visible()) {
+		hud.line("draws %d in %d calls", cull_stats.drawn, cull_stats.batches);
+		if (crowd_mode)
+			hud.line("robots %d: %d full %d imp.", crowd_stats.robots - crowd_stats.culled - crowd_stats.occluded,
+			         crowd_stats.full + crowd_stats.crossfading, crowd_stats.impostors);
+		hud.draw();
+	}
+
+	telemetry.set("draws", cull_stats.drawn);
+	telemetry.set("draw_calls", cull_stats.batches);
+	telemetry.set("robots_full", crowd_mode ? crowd_stats.full + crowd_stats.crossfading : 1);
+	telemetry.set("robots_impostor", crowd_mode ? crowd_stats.impostors : 0);
 
-	glutSwapBuffers();
+	PresentFrame();
 }
 
 //----------------------------------------------------------------------------
@@ -374,8 +642,34 @@ keyboard( unsigned char key, int x, int y )
     switch( key ) {
        case 033: // Escape Key
        case 'q': case 'Q':
+          frame_capture.stop();
+          frame_stats.stop();
           exit( EXIT_SUCCESS );
           break;
+       case 'r': case 'R':
+          if (frame_capture.active())
+             frame_capture.stop();
+          else
+             frame_capture.start(CaptureSettings::from_environment());
+          break;
+       case 'h': case 'H':
+          hud.toggle();
+          break;
+       case 'c': case 'C':
+          crowd_mode = !crowd_mode;
+          break;
+       case 'i': case 'I':
+          use_impostors = !use_impostors;
+          break;
+       case 'm': case 'M':
+          if (budget_pass == BUDGET_OFF) {
+             crowd_mode = true;
+             budget_pass = BUDGET_FULL;
+             budget_frame = 0;
+             budget_ms = 0.0;
+             budget_robots = 0;
+          }
+          break;
     }
 }
 
@@ -398,10 +692,7 @@ mouse( int button, int state, int x, int y )
 void
 update( void )
 {
-	ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-		std::chrono::system_clock::now().time_since_epoch()).count();
-
-	the_time = (ms % 1000000) / 1000.0;
+	the_time = FrameTime();
 
 	Axis = Yaxis;
     Theta[Axis] += 0.5;
@@ -420,7 +711,6 @@ reshape( int width, int height )
 
    GLfloat aspect = GLfloat(width)/height;
    //glm::mat4  projection = glm::perspective( glm::radians(45.0f), aspect, 0.5f, 3.0f );
-   glm::mat4  projection = glm::perspective(glm::radians(45.0f), aspect, 0.5f, 5.0f);
-
-   glUniformMatrix4fv( Projection, 1, GL_FALSE, glm::value_ptr(projection) );
+   frame_uniforms.projection = glm::perspective(glm::radians(45.0f), aspect, 0.5f, 5.0f);
+   lod_pixels_per_unit = 0.5f * height / std::tan(glm::radians(22.5f));
 }
@@ -0,0 +1,136 @@
+// Affine 3x4 transforms
+//
+// The bottom row of every model transform in the demos is (0, 0, 0, 1), so only
+// the top three rows are stored. Composing two of them costs 36 multiplies instead
+// of the 64 of a mat4 product, translate/rotate/scale can be fused into one
+// construction, and uploading them to the GPU takes 48 bytes instead of 64.
+
+#ifndef AFFINE_H
+#define AFFINE_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  include <xmmintrin.h>
+#  define AFFINE_SSE 1
+#endif
+
+// Row-major: rows[i] = (m[i][0], m[i][1], m[i][2], translation[i]).
+// Uploaded as a GLSL mat3x4 whose columns are these rows (see vshader6.glsl).
+struct Affine {
+	glm::vec4 rows[3];
+
+	Affine() {
+		rows[0] = glm::vec4(1, 0, 0, 0);
+		rows[1] = glm::vec4(0, 1, 0, 0);
+		rows[2] = glm::vec4(0, 0, 1, 0);
+	}
+
+	Affine(const glm::vec4 &r0, const glm::vec4 &r1, const glm::vec4 &r2) {
+		rows[0] = r0;
+		rows[1] = r1;
+		rows[2] = r2;
+	}
+
+	// Drops the bottom row of a (column-major) glm matrix
+	explicit Affine(const glm::mat4 &m) {
+		for (int i = 0; i < 3; i++)
+			rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+
+	glm::mat4 to_mat4() const {
+		glm::mat4 m;
+		for (int i = 0; i < 3; i++) {
+			m[0][i] = rows[i].x;
+			m[1][i] = rows[i].y;
+			m[2][i] = rows[i].z;
+			m[3][i] = rows[i].w;
+		}
+		return m;
+	}
+
+	glm::vec3 translation() const {
+		return glm::vec3(rows[0].w, rows[1].w, rows[2].w);
+	}
+
+	glm::vec3 transform_point(const glm::vec3 &p) const {
+		glm::vec4 h(p, 1.0f);
+		return glm::vec3(glm::dot(rows[0], h), glm::dot(rows[1], h), glm::dot(rows[2], h));
+	}
+};
+
+// out = a * b
+inline void affine_compose(const Affine &a, const Affine &b, Affine &out) {
+#ifdef AFFINE_SSE
+	__m128 b0 = _mm_loadu_ps(&b.rows[0].x);
+	__m128 b1 = _mm_loadu_ps(&b.rows[1].x);
+	__m128 b2 = _mm_loadu_ps(&b.rows[2].x);
+	const __m128 w = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < 3; i++) {
+		__m128 r = _mm_loadu_ps(&a.rows[i].x);
+		__m128 acc = _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)), w));
+		_mm_storeu_ps(&out.rows[i].x, acc);
+	}
+#else
+	Affine r;
+	for (int i = 0; i < 3; i++) {
+		const glm::vec4 &ai = a.rows[i];
+		r.rows[i] = ai.x * b.rows[0] + ai.y * b.rows[1] + ai.z * b.rows[2] + glm::vec4(0, 0, 0, ai.w);
+	}
+	out = r;
+#endif
+}
+
+inline Affine operator*(const Affine &a, const Affine &b) {
+	Affine out;
+	affine_compose(a, b, out);
+	return out;
+}
+
+// out[i] = parent * local[i]
+inline void affine_compose_n(const Affine &parent, const Affine *local, Affine *out, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		affine_compose(parent, local[i], out[i]);
+}
+
+// out[i] = parent[i] * local
+inline void affine_compose_n(const Affine *parent, const Affine &local, Affine *out, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		affine_compose(parent[i], local, out[i]);
+}
+
+inline Affine affine_translate(float x, float y, float z) {
+	return Affine(glm::vec4(1, 0, 0, x), glm::vec4(0, 1, 0, y), glm::vec4(0, 0, 1, z));
+}
+
+inline Affine affine_scale(float x, float y, float z) {
+	return Affine(glm::vec4(x, 0, 0, 0), glm::vec4(0, y, 0, 0), glm::vec4(0, 0, z, 0));
+}
+
+// Same convention as rotating a mat4 about x, then y, then z (angles in degrees)
+inline Affine affine_rotate(float rot_x, float rot_y, float rot_z) {
+	float a = glm::radians(rot_x), b = glm::radians(rot_y), c = glm::radians(rot_z);
+	float sa = std::sin(a), ca = std::cos(a);
+	float sb = std::sin(b), cb = std::cos(b);
+	float sc = std::sin(c), cc = std::cos(c);
+	return Affine(
+		glm::vec4(cb*cc, -cb*sc, sb, 0),
+		glm::vec4(sa*sb*cc + ca*sc, ca*cc - sa*sb*sc, -sa*cb, 0),
+		glm::vec4(sa*sc - ca*sb*cc, ca*sb*sc + sa*cc, ca*cb, 0));
+}
+
+// translate * rotate * scale without the intermediate products
+inline Affine affine_trs(const glm::vec3 &t, const glm::vec3 &rot_deg, const glm::vec3 &s) {
+	Affine m = affine_rotate(rot_deg.x, rot_deg.y, rot_deg.z);
+	for (int i = 0; i < 3; i++)
+		m.rows[i] = glm::vec4(m.rows[i].x * s.x, m.rows[i].y * s.y, m.rows[i].z * s.z, t[i]);
+	return m;
+}
+
+#endif // AFFINE_H
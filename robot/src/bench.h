@@ -0,0 +1,28 @@
+// Minimal timing helpers for the headless benchmarks (make bench)
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdio>
+
+// Keeps a result alive so the optimizer cannot drop the benchmarked work
+static volatile float bench_sink;
+
+// Runs f() iters times (after a short warm-up) and returns nanoseconds per call
+template <typename F>
+double bench_ns(F f, long iters) {
+	for (long i = 0; i < iters / 10 + 1; i++)
+		f();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (long i = 0; i < iters; i++)
+		f();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count() / iters;
+}
+
+inline void bench_report(const char *name, double ns, const char *unit = "call") {
+	printf("%-40s %12.1f ns/%s\n", name, ns, unit);
+}
+
+#endif // BENCH_H
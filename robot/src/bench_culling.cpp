@@ -0,0 +1,51 @@
+// Batched bounding sphere tests against the view frustum
+//
+//  make bench && ../build/bench_culling
+
+#include "frustum.h"
+#include "bench.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+const int num_spheres = 4096;
+
+int main() {
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.5f, 5.0f);
+	glm::mat4 view = glm::translate(glm::mat4(), glm::vec3(0.0f, -0.5f, -1.8f));
+	Frustum frustum = frustum_from_matrix(projection * view);
+
+	// a crowd spread well past the edges of the view
+	std::vector<float> x(num_spheres), y(num_spheres), z(num_spheres), r(num_spheres);
+	for (int i = 0; i < num_spheres; i++) {
+		x[i] = (rand() % 1000) * 0.01f - 5.0f;
+		y[i] = (rand() % 100) * 0.01f;
+		z[i] = (rand() % 1000) * 0.01f - 8.0f;
+		r[i] = 0.1f + (rand() % 20) * 0.01f;
+	}
+	std::vector<uint8_t> visible(num_spheres), reference(num_spheres);
+
+	int mismatches = 0, drawn = 0;
+	frustum_test_spheres(frustum, &x[0], &y[0], &z[0], &r[0], num_spheres, &visible[0]);
+	for (int i = 0; i < num_spheres; i++) {
+		reference[i] = frustum_test_sphere(frustum, glm::vec3(x[i], y[i], z[i]), r[i]);
+		mismatches += reference[i] != visible[i];
+		drawn += visible[i];
+	}
+	printf("%d spheres, %d visible, %d mismatches against the scalar test\n", num_spheres, drawn, mismatches);
+
+	double scalar_ns = bench_ns([&]() {
+		for (int i = 0; i < num_spheres; i++)
+			reference[i] = frustum_test_sphere(frustum, glm::vec3(x[i], y[i], z[i]), r[i]);
+		bench_sink = reference[num_spheres / 2];
+	}, 2000);
+	double batch_ns = bench_ns([&]() {
+		frustum_test_spheres(frustum, &x[0], &y[0], &z[0], &r[0], num_spheres, &visible[0]);
+		bench_sink = visible[num_spheres / 2];
+	}, 2000);
+	bench_report("scalar, early out", scalar_ns / num_spheres, "sphere");
+	bench_report(frustum_simd_path(), batch_ns / num_spheres, "sphere");
+	return 0;
+}
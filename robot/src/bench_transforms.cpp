@@ -0,0 +1,112 @@
+// Affine 3x4 transforms vs. the glm::mat4 chains they replaced, for the robot's
+// run cycle: every part of one pose, composed the way display() composes them
+//
+//  make bench && ../build/bench_transforms
+
+#include "affine.h"
+#include "bench.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+// The glm versions of gen_rotate/gen_trans/gen_scale from before the switch to Affine
+struct GlmOps {
+	typedef glm::mat4 M;
+	static M rotate(float rot_x, float rot_y, float rot_z) {
+		glm::mat4 rotate;
+		rotate = glm::rotate(rotate, glm::radians(rot_x), glm::vec3(1, 0, 0));
+		rotate = glm::rotate(rotate, glm::radians(rot_y), glm::vec3(0, 1, 0));
+		rotate = glm::rotate(rotate, glm::radians(rot_z), glm::vec3(0, 0, 1));
+		return rotate;
+	}
+	static M trans(float x, float y, float z) { return glm::translate(glm::mat4(), glm::vec3(x, y, z)); }
+	static M scale(float x, float y, float z) { return glm::scale(glm::mat4(), glm::vec3(x, y, z)); }
+	static M trs(glm::vec3 t, glm::vec3 r, glm::vec3 s) { return trans(t.x, t.y, t.z) * rotate(r.x, r.y, r.z) * scale(s.x, s.y, s.z); }
+};
+
+struct AffineOps {
+	typedef Affine M;
+	static M rotate(float rot_x, float rot_y, float rot_z) { return affine_rotate(rot_x, rot_y, rot_z); }
+	static M trans(float x, float y, float z) { return affine_translate(x, y, z); }
+	static M scale(float x, float y, float z) { return affine_scale(x, y, z); }
+	static M trs(glm::vec3 t, glm::vec3 r, glm::vec3 s) { return affine_trs(t, r, s); }
+};
+
+float wave(float min, float max, float x) {
+	return 0.5*(max - min)*(sin(x) + 1.0) + min;
+}
+
+template <typename Ops>
+int arm(const typename Ops::M &model, float elbow_deg, float shoulder_deg, bool do_end, typename Ops::M *out) {
+	typename Ops::M shoulder = model * Ops::rotate(0.0, 0.0, shoulder_deg);
+	typename Ops::M elbow = shoulder * Ops::trans(0.0, -2.0, 0.0) * Ops::rotate(0.0, 0.0, elbow_deg);
+	int n = 0;
+	out[n++] = shoulder * Ops::trs(glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0), glm::vec3(1.0, 2.0, 1.0));
+	out[n++] = elbow * Ops::trs(glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0), glm::vec3(1.0, 2.0, 1.0));
+	out[n++] = elbow * Ops::scale(0.75, 0.75, 0.75);
+	out[n++] = elbow * Ops::trans(0.0, -2.0, 0.0);
+	if (do_end)
+		out[n++] = elbow * Ops::trs(glm::vec3(0.0, -2.4, 0.0), glm::vec3(180.0, 0.0, 0.0), glm::vec3(1.0));
+	return n;
+}
+
+// Every part of the robot at time t, plus its outline transform
+template <typename Ops>
+int robot_pose(float t, const typename Ops::M &view, typename Ops::M *out) {
+	typedef typename Ops::M M;
+	float scaled_time = t*6.0;
+	float left_shoulder_deg = wave(-45.0, 45.0, scaled_time);
+	float left_elbow_deg = wave(30.0, 90.0, scaled_time);
+	float right_shoulder_deg = -wave(-45.0, 45.0, scaled_time);
+	float right_elbow_deg = 90.0 - wave(0.0, 40.0, scaled_time);
+	float left_knee_deg = -wave(0.0, 80.0, scaled_time);
+	float right_knee_deg = -wave(0.0, 80.0, -scaled_time);
+
+	M model = view * Ops::trans(0.0, 0.63 + 0.04*(sin(2*scaled_time)+0.8), 0.0) * Ops::rotate(0.0, 90.0, 0.0) * Ops::scale(0.08, 0.08, 0.08);
+	int n = 0;
+	n += arm<Ops>(model * Ops::trans(-2.0, 0.0, 0.0) * Ops::rotate(0.0, -90.0, 0.0), left_elbow_deg, left_shoulder_deg, true, out + n);
+	out[n++] = model * Ops::trs(glm::vec3(-1.0, 0.0, 0.0), glm::vec3(-left_shoulder_deg, 0.0, 0.0), glm::vec3(1.5, 0.5, 0.5));
+	out[n++] = model * Ops::trs(glm::vec3(-2.0, 0.0, 0.0), glm::vec3(-left_shoulder_deg, 0.0, 0.0), glm::vec3(0.6));
+	n += arm<Ops>(model * Ops::trans(2.0, 0.0, 0.0) * Ops::rotate(0.0, -90.0, 0.0), right_elbow_deg, right_shoulder_deg, true, out + n);
+	out[n++] = model * Ops::trs(glm::vec3(1.0, 0.0, 0.0), glm::vec3(-right_shoulder_deg, 0.0, 0.0), glm::vec3(1.5, 0.5, 0.5));
+	out[n++] = model * Ops::trs(glm::vec3(2.0, 0.0, 0.0), glm::vec3(-right_shoulder_deg, 0.0, 0.0), glm::vec3(0.6));
+	out[n++] = model * Ops::trs(glm::vec3(0.0, -1.5, 0.0), glm::vec3(0.0), glm::vec3(2.1, 4.0, 1.5));
+	n += arm<Ops>(model * Ops::trans(-0.8, -3.5, 0.0) * Ops::rotate(0.0, -90.0, 0.0), left_knee_deg, right_shoulder_deg, false, out + n);
+	out[n++] = model * Ops::trs(glm::vec3(-0.8, -3.5, 0.0), glm::vec3(-right_shoulder_deg, 0.0, 0.0), glm::vec3(0.7));
+	n += arm<Ops>(model * Ops::trans(0.8, -3.5, 0.0) * Ops::rotate(0.0, -90.0, 0.0), right_knee_deg, left_shoulder_deg, false, out + n);
+	out[n++] = model * Ops::trs(glm::vec3(0.8, -3.5, 0.0), glm::vec3(-left_shoulder_deg, 0.0, 0.0), glm::vec3(0.7));
+	out[n++] = model * Ops::trs(glm::vec3(0.0, 0.75, 0.0), glm::vec3(0.0), glm::vec3(0.4));
+	out[n++] = model * Ops::trs(glm::vec3(0.0, 1.25, 0.0), glm::vec3(0.0), glm::vec3(1.2));
+
+	// outlines
+	M eps_scale = Ops::scale(1.001, 1.001, 1.001);
+	for (int i = 0, parts = n; i < parts; i++)
+		out[n++] = out[i] * eps_scale;
+	return n;
+}
+
+int main() {
+	glm::mat4 glm_out[64];
+	Affine affine_out[64];
+	int parts = robot_pose<AffineOps>(0.0, Affine(), affine_out);
+	float t = 0.0;
+
+	printf("robot run cycle, %d transforms per pose\n", parts);
+
+	double ns = bench_ns([&]() {
+		robot_pose<GlmOps>(t += 0.001f, GlmOps::trans(0.0, -0.5, -1.8) * GlmOps::rotate(0.0, 30.0, 0.0), glm_out);
+		bench_sink = glm_out[0][3][0];
+	}, 200000);
+	bench_report("pose  glm::mat4", ns, "robot");
+
+	ns = bench_ns([&]() {
+		robot_pose<AffineOps>(t += 0.001f, AffineOps::trans(0.0, -0.5, -1.8) * AffineOps::rotate(0.0, 30.0, 0.0), affine_out);
+		bench_sink = affine_out[0].rows[0].w;
+	}, 200000);
+	bench_report("pose  Affine", ns, "robot");
+
+	printf("upload size per pose: mat4 %u bytes, Affine %u bytes\n", unsigned(parts * sizeof(glm::mat4)), unsigned(parts * sizeof(Affine)));
+	return 0;
+}
@@ -0,0 +1,199 @@
+// Image files for captured frames
+
+#include "capture_encode.h"
+
+#include <cstdio>
+#include <cstring>
+
+const char *capture_extension(CaptureFormat format) {
+	switch (format) {
+	case CAPTURE_PPM: return "ppm";
+	case CAPTURE_PNG: return "png";
+	case CAPTURE_YUV: return "yuv";
+	}
+	return "";
+}
+
+bool capture_format_from_name(const char *name, CaptureFormat &format) {
+	const CaptureFormat formats[] = { CAPTURE_PPM, CAPTURE_PNG, CAPTURE_YUV };
+	for (CaptureFormat f : formats) {
+		if (strcmp(name, capture_extension(f)) == 0) {
+			format = f;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void put_be32(std::vector<unsigned char> &out, unsigned value) {
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+// the rows top first, as RGB
+static void append_rgb_rows(const unsigned char *rgba, int width, int height, std::vector<unsigned char> &out,
+                            bool png_filter_byte) {
+	for (int y = height - 1; y >= 0; y--) {
+		if (png_filter_byte)
+			out.push_back(0);
+		const unsigned char *src = rgba + size_t(y) * width * 4;
+		size_t at = out.size();
+		out.resize(at + size_t(width) * 3);
+		unsigned char *dst = &out[at];
+		for (int x = 0; x < width; x++, src += 4, dst += 3) {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		}
+	}
+}
+
+static void encode_ppm(const unsigned char *rgba, int width, int height, std::vector<unsigned char> &out) {
+	char header[64];
+	int length = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+	out.insert(out.end(), header, header + length);
+	append_rgb_rows(rgba, width, height, out, false);
+}
+
+struct CrcTable {
+	unsigned entries[256];
+
+	CrcTable() {
+		for (unsigned n = 0; n < 256; n++) {
+			unsigned c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			entries[n] = c;
+		}
+	}
+};
+
+static unsigned crc32(unsigned crc, const unsigned char *data, size_t length) {
+	static const CrcTable table;    // built once, even with several encoder threads
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static unsigned adler32(const unsigned char *data, size_t length) {
+	unsigned a = 1, b = 0;
+	while (length > 0) {
+		// the most bytes before b can overflow
+		size_t n = length < 5552 ? length : 5552;
+		length -= n;
+		while (n--) {
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+static void put_png_chunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, size_t length) {
+	put_be32(out, unsigned(length));
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + length);
+	put_be32(out, crc32(0, &out[start], length + 4));
+}
+
+static void encode_png(const unsigned char *rgba, int width, int height, std::vector<unsigned char> &out) {
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	out.insert(out.end(), signature, signature + 8);
+
+	std::vector<unsigned char> header;
+	put_be32(header, unsigned(width));
+	put_be32(header, unsigned(height));
+	const unsigned char ihdr_rest[5] = { 8, 2, 0, 0, 0 };     // 8-bit RGB, no interlace
+	header.insert(header.end(), ihdr_rest, ihdr_rest + 5);
+	put_png_chunk(out, "IHDR", &header[0], header.size());
+
+	std::vector<unsigned char> raw;
+	raw.reserve(size_t(height) * (size_t(width) * 3 + 1));
+	append_rgb_rows(rgba, width, height, raw, true);
+
+	// zlib stream of stored deflate blocks
+	std::vector<unsigned char> z;
+	z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	z.push_back(0x78);
+	z.push_back(0x01);
+	for (size_t at = 0; at < raw.size(); ) {
+		size_t length = raw.size() - at < 65535 ? raw.size() - at : 65535;
+		bool last = at + length == raw.size();
+		z.push_back(last ? 1 : 0);
+		z.push_back((unsigned char)length);
+		z.push_back((unsigned char)(length >> 8));
+		z.push_back((unsigned char)~length);
+		z.push_back((unsigned char)(~length >> 8));
+		z.insert(z.end(), raw.begin() + at, raw.begin() + at + length);
+		at += length;
+	}
+	put_be32(z, adler32(&raw[0], raw.size()));
+	put_png_chunk(out, "IDAT", &z[0], z.size());
+	put_png_chunk(out, "IEND", NULL, 0);
+}
+
+static void encode_yuv(const unsigned char *rgba, int width, int height, std::vector<unsigned char> &out) {
+	int chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+	size_t y_size = size_t(width) * height, c_size = size_t(chroma_width) * chroma_height;
+	size_t at = out.size();
+	out.resize(at + y_size + 2 * c_size);
+	unsigned char *luma = &out[at], *u_plane = luma + y_size, *v_plane = u_plane + c_size;
+
+	for (int y = 0; y < height; y++) {
+		const unsigned char *src = rgba + size_t(height - 1 - y) * width * 4;
+		unsigned char *dst = luma + size_t(y) * width;
+		for (int x = 0; x < width; x++, src += 4)
+			dst[x] = (unsigned char)(((66 * src[0] + 129 * src[1] + 25 * src[2] + 128) >> 8) + 16);
+	}
+	for (int cy = 0; cy < chroma_height; cy++) {
+		for (int cx = 0; cx < chroma_width; cx++) {
+			int r = 0, g = 0, b = 0, n = 0;
+			for (int dy = 0; dy < 2; dy++) {
+				int y = 2 * cy + dy;
+				if (y >= height)
+					continue;
+				for (int dx = 0; dx < 2; dx++) {
+					int x = 2 * cx + dx;
+					if (x >= width)
+						continue;
+					const unsigned char *p = rgba + (size_t(height - 1 - y) * width + x) * 4;
+					r += p[0];
+					g += p[1];
+					b += p[2];
+					n++;
+				}
+			}
+			r /= n;
+			g /= n;
+			b /= n;
+			u_plane[size_t(cy) * chroma_width + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			v_plane[size_t(cy) * chroma_width + cx] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+}
+
+void encode_capture(CaptureFormat format, const unsigned char *rgba, int width, int height,
+                    std::vector<unsigned char> &out) {
+	out.clear();
+	switch (format) {
+	case CAPTURE_PPM: encode_ppm(rgba, width, height, out); break;
+	case CAPTURE_PNG: encode_png(rgba, width, height, out); break;
+	case CAPTURE_YUV: encode_yuv(rgba, width, height, out); break;
+	}
+}
+
+bool write_capture(const char *path, CaptureFormat format, const unsigned char *rgba, int width, int height,
+                   std::vector<unsigned char> &scratch) {
+	encode_capture(format, rgba, width, height, scratch);
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	bool ok = fwrite(&scratch[0], 1, scratch.size(), fp) == scratch.size();
+	return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,30 @@
+// Image files for captured frames
+//
+// The encoders take RGBA pixels in OpenGL row order (bottom row first) and write
+// one file per frame:
+//   ppm  binary P6
+//   png  8-bit RGB in stored (uncompressed) deflate blocks, so no zlib is needed;
+//        large, but written at disk speed
+//   yuv  raw I420 (BT.601, limited range), e.g.
+//        ffmpeg -f rawvideo -pix_fmt yuv420p -s WxH -i frame_%06d.yuv ...
+
+#ifndef CAPTURE_ENCODE_H
+#define CAPTURE_ENCODE_H
+
+#include <vector>
+
+enum CaptureFormat { CAPTURE_PPM, CAPTURE_PNG, CAPTURE_YUV };
+
+// "ppm", "png" or "yuv"
+extern const char *capture_extension(CaptureFormat format);
+// Parses an extension; false when it is not one of the above
+extern bool capture_format_from_name(const char *name, CaptureFormat &format);
+
+extern void encode_capture(CaptureFormat format, const unsigned char *rgba, int width, int height,
+                           std::vector<unsigned char> &out);
+
+// Encodes and writes path; false when the file could not be written
+extern bool write_capture(const char *path, CaptureFormat format, const unsigned char *rgba, int width, int height,
+                          std::vector<unsigned char> &scratch);
+
+#endif // CAPTURE_ENCODE_H
@@ -0,0 +1,286 @@
+// Asynchronous frame capture to an image sequence
+
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#  include <direct.h>
+#else
+#  include <sys/stat.h>
+#endif
+
+FrameCapture frame_capture;
+
+CaptureSettings CaptureSettings::from_environment() {
+	CaptureSettings settings;
+	const char *directory = getenv("CAPTURE_DIR");
+	if (directory != NULL && *directory != '\0')
+		settings.directory = directory;
+	const char *format = getenv("CAPTURE_FORMAT");
+	if (format != NULL && !capture_format_from_name(format, settings.format))
+		std::cerr << "unknown CAPTURE_FORMAT " << format << ", writing " << capture_extension(settings.format) << std::endl;
+	const char *policy = getenv("CAPTURE_POLICY");
+	if (policy != NULL)
+		settings.policy = strcmp(policy, "block") == 0 ? CAPTURE_BLOCK : CAPTURE_DROP;
+	return settings;
+}
+
+FrameCapture::FrameCapture() : capturing(false), next_slot(0), next_frame(0), written(0), dropped(0), failed(0),
+                               stopping(false) {
+	memset(&current, 0, sizeof(current));
+	for (Slot &slot : slots) {
+		slot.buffer = 0;
+		slot.capacity = 0;
+		slot.fence = 0;
+		slot.state = SLOT_FREE;
+		slot.pixels = NULL;
+		slot.copied = false;
+	}
+}
+
+FrameCapture::~FrameCapture() {
+	stop();
+}
+
+void FrameCapture::start(const CaptureSettings &s) {
+	if (capturing)
+		return;
+	settings = s;
+#ifdef _WIN32
+	_mkdir(settings.directory.c_str());
+#else
+	mkdir(settings.directory.c_str(), 0755);
+#endif
+
+	if (slots[0].buffer == 0)
+		for (Slot &slot : slots)
+			glGenBuffers(1, &slot.buffer);
+
+	frames.assign(std::max(1, settings.queue_frames), Frame());
+	free_frames.clear();
+	for (Frame &frame : frames)
+		free_frames.push_back(&frame);
+	memset(&current, 0, sizeof(current));
+	written = dropped = failed = 0;
+	stopping = false;
+
+	int num_encoders = settings.encoders > 0 ? settings.encoders : int(std::thread::hardware_concurrency()) / 2;
+	copier = std::thread(&FrameCapture::copy_loop, this);
+	for (int i = 0; i < std::max(1, num_encoders); i++)
+		encoders.push_back(std::thread(&FrameCapture::encode_loop, this));
+	capturing = true;
+}
+
+void FrameCapture::capture(long frame) {
+	if (!capturing)
+		return;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	poll();
+	Slot &slot = slots[next_slot];
+	if (slot.state != SLOT_FREE)
+		reclaim(slot);
+	read_back(slot, frame >= 0 ? frame : next_frame);
+	next_frame++;
+	next_slot = (next_slot + 1) % RING_SIZE;
+
+	current.captured++;
+	current.written = written;
+	current.dropped = dropped;
+	current.failed = failed;
+	current.render_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void FrameCapture::stop() {
+	if (!capturing)
+		return;
+	for (int i = 0; i < RING_SIZE; i++) {
+		Slot &slot = slots[(next_slot + i) % RING_SIZE];
+		if (slot.state != SLOT_FREE)
+			reclaim(slot);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	copy_ready.notify_all();
+	encode_ready.notify_all();
+	copier.join();
+	for (std::thread &encoder : encoders)
+		encoder.join();
+	encoders.clear();
+	capturing = false;
+
+	current.written = written;
+	current.dropped = dropped;
+	current.failed = failed;
+#ifdef DEBUG
+	std::cout << "capture: " << current.captured << " frames, " << current.written << " written to "
+	          << settings.directory << ", " << current.dropped << " dropped, " << current.failed << " failed; "
+	          << (current.captured > 0 ? current.render_ms / current.captured : 0.0) << " ms per frame on the render thread"
+	          << std::endl;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Render thread
+
+// Hands the readbacks that have finished to the copier, oldest first, and unmaps
+// the buffers it is done with; never waits
+void FrameCapture::poll() {
+	for (int i = 0; i < RING_SIZE; i++) {
+		Slot &slot = slots[(next_slot + i) % RING_SIZE];
+		if (slot.state == SLOT_READING) {
+			GLenum status = glClientWaitSync(slot.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+			map(slot);
+		}
+		if (slot.state == SLOT_MAPPED) {
+			bool copied;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				copied = slot.copied;
+			}
+			if (copied) {
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+				slot.state = SLOT_FREE;
+			}
+		}
+	}
+}
+
+void FrameCapture::map(Slot &slot) {
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	slot.pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(slot.width) * slot.height * 4,
+	                                                      GL_MAP_READ_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (slot.pixels == NULL) {
+		failed++;
+		slot.state = SLOT_FREE;
+		return;
+	}
+
+	slot.state = SLOT_MAPPED;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.copied = false;
+		to_copy.push_back(&slot);
+	}
+	copy_ready.notify_one();
+}
+
+// Waits until the slot is free again: for its readback, then for the copier
+void FrameCapture::reclaim(Slot &slot) {
+	if (slot.state == SLOT_READING) {
+		while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) == GL_TIMEOUT_EXPIRED)
+			;
+		map(slot);
+	}
+	if (slot.state == SLOT_MAPPED) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			slot_copied.wait(lock, [&]() { return slot.copied; });
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.state = SLOT_FREE;
+	}
+}
+
+void FrameCapture::read_back(Slot &slot, long frame) {
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	slot.width = viewport[2];
+	slot.height = viewport[3];
+	GLsizeiptr bytes = GLsizeiptr(slot.width) * slot.height * 4;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	if (bytes > slot.capacity) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		slot.capacity = bytes;
+	}
+	// into the bound buffer: returns as soon as the copy is queued
+	glReadPixels(viewport[0], viewport[1], slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, BUFFER_OFFSET(0));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frame = frame;
+	slot.state = SLOT_READING;
+}
+
+//----------------------------------------------------------------------------
+// Worker threads
+
+void FrameCapture::copy_loop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		copy_ready.wait(lock, [&]() { return stopping || !to_copy.empty(); });
+		if (to_copy.empty())
+			return;
+		Slot *slot = to_copy.front();
+		to_copy.pop_front();
+
+		if (settings.policy == CAPTURE_BLOCK)
+			frame_freed.wait(lock, [&]() { return !free_frames.empty(); });
+		Frame *frame = NULL;
+		if (!free_frames.empty()) {
+			frame = free_frames.back();
+			free_frames.pop_back();
+		}
+
+		lock.unlock();
+		if (frame != NULL) {
+			frame->frame = slot->frame;
+			frame->width = slot->width;
+			frame->height = slot->height;
+			frame->pixels.assign(slot->pixels, slot->pixels + size_t(slot->width) * slot->height * 4);
+		} else {
+			dropped++;
+		}
+		lock.lock();
+
+		slot->copied = true;
+		slot_copied.notify_all();
+		if (frame != NULL) {
+			to_encode.push_back(frame);
+			encode_ready.notify_one();
+		}
+	}
+}
+
+void FrameCapture::encode_loop() {
+	std::vector<unsigned char> scratch;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		encode_ready.wait(lock, [&]() { return stopping || !to_encode.empty(); });
+		if (to_encode.empty())
+			return;
+		Frame *frame = to_encode.front();
+		to_encode.pop_front();
+		lock.unlock();
+
+		char path[512];
+		snprintf(path, sizeof(path), "%s/frame_%06ld.%s", settings.directory.c_str(), frame->frame,
+		         capture_extension(settings.format));
+		if (write_capture(path, settings.format, &frame->pixels[0], frame->width, frame->height, scratch))
+			written++;
+		else
+			failed++;
+
+		lock.lock();
+		free_frames.push_back(frame);
+		frame_freed.notify_one();
+	}
+}
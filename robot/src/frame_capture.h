@@ -0,0 +1,120 @@
+// Asynchronous frame capture to an image sequence
+//
+// capture() runs just before the swap: it starts an asynchronous glReadPixels of
+// the back buffer into one of a small ring of pixel-pack buffers and fences it.
+// A later frame maps the buffer once its fence has signalled; a copier thread
+// copies the pixels out of the mapping into a pooled frame and the render thread
+// unmaps it, so the render thread itself never waits for the GPU or touches the
+// pixels. A pool of encoder threads writes the frames as <directory>/frame_NNNNNN
+// files (see capture_encode.h). The frame pool is the bounded queue between the
+// two: when the encoders fall behind, new frames are dropped or the capture
+// blocks, as chosen by the policy.
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "common.h"
+#include "capture_encode.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum CapturePolicy { CAPTURE_DROP, CAPTURE_BLOCK };
+
+struct CaptureSettings {
+	std::string directory;     // created when missing
+	CaptureFormat format;
+	CapturePolicy policy;      // when every pooled frame is waiting for an encoder
+	int queue_frames;          // pooled frames
+	int encoders;              // <= 0 picks half the hardware threads
+
+	CaptureSettings() : directory("capture"), format(CAPTURE_PNG), policy(CAPTURE_DROP), queue_frames(8), encoders(0) {}
+
+	// The defaults, overridden by CAPTURE_DIR, CAPTURE_FORMAT (ppm, png or yuv) and
+	// CAPTURE_POLICY (drop or block)
+	static CaptureSettings from_environment();
+};
+
+struct CaptureStats {
+	long captured;             // read back from the GPU
+	long written;
+	long dropped;              // no pooled frame was free
+	long failed;               // could not be written
+	double render_ms;          // total time spent in capture() on the render thread
+};
+
+class FrameCapture {
+public:
+	static const int RING_SIZE = 3;
+
+	FrameCapture();
+	~FrameCapture();
+
+	// GL thread only
+	void start(const CaptureSettings &settings);
+	// frame names the file; by default frames are numbered from 0 in capture order
+	void capture(long frame = -1);
+	// Finishes the readbacks in flight and waits until every frame is written
+	void stop();
+
+	bool active() const { return capturing; }
+	const CaptureStats &stats() const { return current; }
+
+private:
+	enum SlotState { SLOT_FREE, SLOT_READING, SLOT_MAPPED };
+
+	struct Slot {
+		GLuint buffer;
+		GLsizeiptr capacity;
+		GLsync fence;
+		SlotState state;
+		long frame;
+		int width, height;
+		const unsigned char *pixels;   // while mapped
+		bool copied;                   // guarded by mutex
+	};
+
+	struct Frame {
+		long frame;
+		int width, height;
+		std::vector<unsigned char> pixels;
+	};
+
+	CaptureSettings settings;
+	bool capturing;
+	CaptureStats current;
+	Slot slots[RING_SIZE];
+	int next_slot;
+	long next_frame;
+
+	std::mutex mutex;
+	std::condition_variable copy_ready, slot_copied, encode_ready, frame_freed;
+	std::deque<Slot *> to_copy;
+	std::deque<Frame *> to_encode;
+	std::vector<Frame *> free_frames;
+	std::vector<Frame> frames;
+	std::atomic<long> written, dropped, failed;
+	bool stopping;
+	std::thread copier;
+	std::vector<std::thread> encoders;
+
+	void poll();
+	void map(Slot &slot);
+	void reclaim(Slot &slot);
+	void read_back(Slot &slot, long frame);
+
+	void copy_loop();
+	void encode_loop();
+
+	FrameCapture(const FrameCapture &);
+	FrameCapture &operator=(const FrameCapture &);
+};
+
+extern FrameCapture frame_capture;
+
+#endif // FRAME_CAPTURE_H
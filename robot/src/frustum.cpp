@@ -0,0 +1,71 @@
+// View frustum and bounding sphere tests
+
+#include "frustum.h"
+
+Frustum frustum_from_matrix(const glm::mat4 &m) {
+	// rows of the (column-major) matrix
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = row[3] + row[0];
+	frustum.planes[1] = row[3] - row[0];
+	frustum.planes[2] = row[3] + row[1];
+	frustum.planes[3] = row[3] - row[1];
+	frustum.planes[4] = row[3] + row[2];
+	frustum.planes[5] = row[3] - row[2];
+	for (int i = 0; i < 6; i++)
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+	return frustum;
+}
+
+void frustum_test_spheres(const Frustum &frustum, const float *x, const float *y, const float *z,
+                          const float *r, int n, uint8_t *visible) {
+	int i = 0;
+#if defined(FRUSTUM_AVX)
+	for (; i + 8 <= n; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		__m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(r + i));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4 &plane = frustum.planes[p];
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+			d = _mm256_add_ps(d, _mm256_mul_ps(py, _mm256_set1_ps(plane.y)));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pz, _mm256_set1_ps(plane.z)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg_r, _CMP_GE_OQ));
+		}
+		int bits = _mm256_movemask_ps(inside);
+		for (int k = 0; k < 8; k++)
+			visible[i + k] = uint8_t((bits >> k) & 1);
+	}
+#elif defined(FRUSTUM_SSE)
+	for (; i + 4 <= n; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		__m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+		__m128 inside = _mm_cmpeq_ps(px, px);     // all ones, except for NaN positions
+		for (int p = 0; p < 6; p++) {
+			const glm::vec4 &plane = frustum.planes[p];
+			__m128 d = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+			d = _mm_add_ps(d, _mm_mul_ps(py, _mm_set1_ps(plane.y)));
+			d = _mm_add_ps(d, _mm_mul_ps(pz, _mm_set1_ps(plane.z)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+		}
+		int bits = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; k++)
+			visible[i + k] = uint8_t((bits >> k) & 1);
+	}
+#endif
+	for (; i < n; i++)
+		visible[i] = frustum_test_sphere(frustum, glm::vec3(x[i], y[i], z[i]), r[i]) ? 1 : 0;
+}
+
+const char *frustum_simd_path() {
+#if defined(FRUSTUM_AVX)
+	return "AVX, 8 per pass";
+#elif defined(FRUSTUM_SSE)
+	return "SSE, 4 per pass";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,44 @@
+// View frustum and bounding sphere tests
+//
+// The six planes are taken from projection * view, so the tests run on world
+// space bounding spheres. Spheres are tested in structure-of-arrays batches: eight
+// per pass with AVX, four with SSE, and one at a time otherwise.
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#  define FRUSTUM_AVX 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  include <xmmintrin.h>
+#  define FRUSTUM_SSE 1
+#endif
+
+// planes[i] = (a, b, c, d) with a unit normal pointing inside: a*x + b*y + c*z + d >= 0
+// inside. Order: left, right, bottom, top, near, far.
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+extern Frustum frustum_from_matrix(const glm::mat4 &view_projection);
+
+inline bool frustum_test_sphere(const Frustum &frustum, const glm::vec3 &center, float radius) {
+	for (int i = 0; i < 6; i++)
+		if (glm::dot(glm::vec3(frustum.planes[i]), center) + frustum.planes[i].w < -radius)
+			return false;
+	return true;
+}
+
+// visible[i] = 1 when sphere (x[i], y[i], z[i]), radius r[i] touches the frustum, else 0
+extern void frustum_test_spheres(const Frustum &frustum, const float *x, const float *y, const float *z,
+                                 const float *r, int n, uint8_t *visible);
+
+// Name of the compiled batch path, for benchmark output
+extern const char *frustum_simd_path();
+
+#endif // FRUSTUM_H
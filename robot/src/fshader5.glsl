@@ -1,27 +1,53 @@
 #version 150
 
+layout(std140) uniform FrameBlock {
+    mat4 Projection;
+    mat4 View;
+    vec4 Time;
+};
+
+uniform sampler2D atlas;
+
 in vec4 color;
 in vec2 uv;
-flat in float time;
-flat in int is_floor;
+flat in int surface;       // 0 = flat color, 1 = animated floor, 2 = impostor
 
 out vec4 fColor;
 
+// 4x4 ordered dither; alpha below 1 fades a draw out through a screen-door pattern,
+// and impostors use the complementary pattern so the two LOD levels crossfade
+const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                  3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+float dither()
+{
+	ivec2 p = ivec2(gl_FragCoord.xy) % 4;
+	return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
 float u, v, result;
 float size = 16.0;
 float speed = 10.0;
 
 void main() 
 {
-	if(is_floor == 1){
+	if(surface == 1){
 	    u = uv[0];
 	    v = uv[1];
 
-		result = mod(floor(size*u+speed*float(time)) + floor(size*v), 2.0);
+		result = mod(floor(size*u+speed*Time.x) + floor(size*v), 2.0);
 	    
 		fColor = vec4(0.0, result - 0.5, 0.2, 1.0);
 	}
+	else if(surface == 2){
+		vec4 texel = texture(atlas, uv);
+		if(texel.a < 0.5 || 1.0 - dither() >= color.a)
+			discard;
+		fColor = vec4(texel.rgb, 1.0);
+	}
    	else{
-   		fColor = color;
+		if(dither() >= color.a)
+			discard;
+   		fColor = vec4(color.rgb, 1.0);
    	}
 }
@@ -0,0 +1,18 @@
+#version 150
+
+// The font texture holds coverage; solid quads sample its filled cell
+
+uniform sampler2D font;
+
+in vec2 uv_pos;
+in vec4 draw_color;
+
+out vec4 color;
+
+void main()
+{
+    float coverage = texture(font, uv_pos).r;
+    if (coverage == 0.0)
+        discard;
+    color = vec4(draw_color.rgb, draw_color.a * coverage);
+}
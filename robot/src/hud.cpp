@@ -0,0 +1,258 @@
+// Performance overlay
+
+#include "hud.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+
+Hud hud;
+
+// 5x7 font for ASCII 32-126, one byte per column, least significant bit at the top
+static const unsigned char font_columns[95][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5f, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },  //  !"
+	{ 0x14, 0x7f, 0x14, 0x7f, 0x14 }, { 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },  // #$%
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1c, 0x22, 0x41, 0x00 },  // &'(
+	{ 0x00, 0x41, 0x22, 0x1c, 0x00 }, { 0x08, 0x2a, 0x1c, 0x2a, 0x08 }, { 0x08, 0x08, 0x3e, 0x08, 0x08 },  // )*+
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },  // ,-.
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x3e, 0x51, 0x49, 0x45, 0x3e }, { 0x00, 0x42, 0x7f, 0x40, 0x00 },  // /01
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4b, 0x31 }, { 0x18, 0x14, 0x12, 0x7f, 0x10 },  // 234
+	{ 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3c, 0x4a, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },  // 567
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1e }, { 0x00, 0x36, 0x36, 0x00, 0x00 },  // 89:
+	{ 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },  // ;<=
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 }, { 0x32, 0x49, 0x79, 0x41, 0x3e },  // >?@
+	{ 0x7e, 0x11, 0x11, 0x11, 0x7e }, { 0x7f, 0x49, 0x49, 0x49, 0x36 }, { 0x3e, 0x41, 0x41, 0x41, 0x22 },  // ABC
+	{ 0x7f, 0x41, 0x41, 0x22, 0x1c }, { 0x7f, 0x49, 0x49, 0x49, 0x41 }, { 0x7f, 0x09, 0x09, 0x09, 0x01 },  // DEF
+	{ 0x3e, 0x41, 0x49, 0x49, 0x7a }, { 0x7f, 0x08, 0x08, 0x08, 0x7f }, { 0x00, 0x41, 0x7f, 0x41, 0x00 },  // GHI
+	{ 0x20, 0x40, 0x41, 0x3f, 0x01 }, { 0x7f, 0x08, 0x14, 0x22, 0x41 }, { 0x7f, 0x40, 0x40, 0x40, 0x40 },  // JKL
+	{ 0x7f, 0x02, 0x0c, 0x02, 0x7f }, { 0x7f, 0x04, 0x08, 0x10, 0x7f }, { 0x3e, 0x41, 0x41, 0x41, 0x3e },  // MNO
+	{ 0x7f, 0x09, 0x09, 0x09, 0x06 }, { 0x3e, 0x41, 0x51, 0x21, 0x5e }, { 0x7f, 0x09, 0x19, 0x29, 0x46 },  // PQR
+	{ 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7f, 0x01, 0x01 }, { 0x3f, 0x40, 0x40, 0x40, 0x3f },  // STU
+	{ 0x1f, 0x20, 0x40, 0x20, 0x1f }, { 0x3f, 0x40, 0x38, 0x40, 0x3f }, { 0x63, 0x14, 0x08, 0x14, 0x63 },  // VWX
+	{ 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7f, 0x41, 0x41, 0x00 },  // YZ[
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7f, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 },  // \]^
+	{ 0x40, 0x40, 0x40, 0x40, 0x40 }, { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },  // _`a
+	{ 0x7f, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 }, { 0x38, 0x44, 0x44, 0x48, 0x7f },  // bcd
+	{ 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7e, 0x09, 0x01, 0x02 }, { 0x0c, 0x52, 0x52, 0x52, 0x3e },  // efg
+	{ 0x7f, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7d, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3d, 0x00 },  // hij
+	{ 0x7f, 0x10, 0x28, 0x44, 0x00 }, { 0x00, 0x41, 0x7f, 0x40, 0x00 }, { 0x7c, 0x04, 0x18, 0x04, 0x78 },  // klm
+	{ 0x7c, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 }, { 0x7c, 0x14, 0x14, 0x14, 0x08 },  // nop
+	{ 0x08, 0x14, 0x14, 0x18, 0x7c }, { 0x7c, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },  // qrs
+	{ 0x04, 0x3f, 0x44, 0x40, 0x20 }, { 0x3c, 0x40, 0x40, 0x20, 0x7c }, { 0x1c, 0x20, 0x40, 0x20, 0x1c },  // tuv
+	{ 0x3c, 0x40, 0x30, 0x40, 0x3c }, { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0c, 0x50, 0x50, 0x50, 0x3c },  // wxy
+	{ 0x44, 0x64, 0x54, 0x4c, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 }, { 0x00, 0x00, 0x7f, 0x00, 0x00 },  // z{|
+	{ 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x02, 0x01, 0x02, 0x04, 0x02 },                                      // }~
+};
+
+// Font texture: a 6x8 cell per glyph, then one filled cell for solid quads
+const int cell_width = 6, cell_height = 8;
+const int font_cells = 96;
+const int solid_cell = 95;
+const int font_width = font_cells * cell_width;
+
+const float graph_ms = 2000.0f / 60.0f;      // top of the graph: two frames at 60 Hz
+const float target_ms = 1000.0f / 60.0f;
+
+Hud::Hud() : program(0), vao(0), buffer(0), font(0), screen_size_location(-1), history_next(0), history_count(0),
+             shown(false), draw_ms(0.0) {
+}
+
+void Hud::init() {
+	// FinishShader() leaves its program current; the demo's stays current instead.
+	// The font is built while the driver compiles.
+	GLint previous_program;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+	program = BeginShader("vshader_hud.glsl", "fshader_hud.glsl");
+
+	std::vector<GLubyte> texels(font_width * cell_height, 0);
+	for (int glyph = 0; glyph < 95; glyph++)
+		for (int column = 0; column < 5; column++)
+			for (int row = 0; row < 7; row++)
+				if (font_columns[glyph][column] & (1 << row))
+					texels[row * font_width + glyph * cell_width + column] = 255;
+	for (int row = 0; row < cell_height; row++)
+		for (int column = 0; column < cell_width; column++)
+			texels[row * font_width + solid_cell * cell_width + column] = 255;
+
+	glGenTextures(1, &font);
+	glActiveTexture(GL_TEXTURE0 + HUD_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, font);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, font_width, cell_height, 0, GL_RED, GL_UNSIGNED_BYTE, &texels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glActiveTexture(GL_TEXTURE0);
+
+	FinishShader(program);
+	screen_size_location = glGetUniformLocation(program, "screen_size");
+	glUniform1i(glGetUniformLocation(program, "font"), HUD_TEXTURE_UNIT);
+
+	GLint previous_vao;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous_vao);
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	GLuint position = glGetAttribLocation(program, "position");
+	GLuint uv = glGetAttribLocation(program, "glyph_uv");
+	GLuint color = glGetAttribLocation(program, "quad_color");
+	glEnableVertexAttribArray(position);
+	glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offsetof(Vertex, x)));
+	glEnableVertexAttribArray(uv);
+	glVertexAttribPointer(uv, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offsetof(Vertex, u)));
+	glEnableVertexAttribArray(color);
+	glVertexAttribPointer(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), BUFFER_OFFSET(offsetof(Vertex, color)));
+	glBindVertexArray(previous_vao);
+	glUseProgram(previous_program);
+}
+
+void Hud::record_frame(const FrameSample &sample) {
+	history[history_next] = sample;
+	history_next = (history_next + 1) % HUD_HISTORY;
+	history_count = std::min(history_count + 1, HUD_HISTORY);
+}
+
+void Hud::line(const char *format, ...) {
+	char buf[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	lines.push_back(buf);
+}
+
+void Hud::quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const glm::vec4 &color) {
+	Vertex corner[4];
+	const float xs[4] = { x0, x1, x1, x0 }, ys[4] = { y0, y0, y1, y1 };
+	const float us[4] = { u0, u1, u1, u0 }, vs[4] = { v0, v0, v1, v1 };
+	for (int i = 0; i < 4; i++) {
+		corner[i].x = xs[i];
+		corner[i].y = ys[i];
+		corner[i].u = us[i];
+		corner[i].v = vs[i];
+		for (int c = 0; c < 4; c++)
+			corner[i].color[c] = GLubyte(glm::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+	const int order[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int i : order)
+		vertices.push_back(corner[i]);
+}
+
+void Hud::rect(float x, float y, float width, float height, const glm::vec4 &color) {
+	float u = (solid_cell * cell_width + 0.5f * cell_width) / font_width;
+	quad(x, y, x + width, y + height, u, 0.5f, u, 0.5f, color);
+}
+
+void Hud::text(float x, float y, const std::string &s, const glm::vec4 &color, float scale) {
+	for (char c : s) {
+		if (c > ' ' && c <= '~') {
+			int cell = c - ' ';
+			float u0 = float(cell * cell_width) / font_width, u1 = float(cell * cell_width + cell_width) / font_width;
+			quad(x, y, x + cell_width * scale, y + cell_height * scale, u0, 0.0f, u1, 1.0f, color);
+		}
+		x += cell_width * scale;
+	}
+}
+
+// Recent frames, oldest on the left: the total time in grey (red when a frame was
+// missed), CPU sim (blue) and submit (green) stacked inside it, the GPU time as a
+// white tick, and the 60 Hz target as a yellow line
+void Hud::graph(float x, float y, float width, float height) {
+	rect(x, y, width, height, glm::vec4(0.0, 0.0, 0.0, 0.4));
+	float bar = width / HUD_HISTORY;
+	float bottom = y + height;
+	auto bar_height = [&](float ms) { return std::min(ms / graph_ms, 1.0f) * height; };
+	for (int i = 0; i < history_count; i++) {
+		const FrameSample &sample = history[(history_next - history_count + i + HUD_HISTORY) % HUD_HISTORY];
+		float left = x + (HUD_HISTORY - history_count + i) * bar;
+		float total = bar_height(sample.ms[FRAME_TOTAL]);
+		float sim = bar_height(sample.ms[FRAME_SIM]);
+		float submit = bar_height(sample.ms[FRAME_SIM] + sample.ms[FRAME_SUBMIT]);
+		bool missed = sample.ms[FRAME_TOTAL] > 1.5f * target_ms;
+		rect(left, bottom - total, bar, total, missed ? glm::vec4(0.9, 0.2, 0.2, 0.8) : glm::vec4(0.6, 0.6, 0.6, 0.8));
+		rect(left, bottom - submit, bar, submit - sim, glm::vec4(0.3, 0.8, 0.3, 0.9));
+		rect(left, bottom - sim, bar, sim, glm::vec4(0.3, 0.5, 1.0, 0.9));
+		if (sample.ms[FRAME_GPU] >= 0.0f)
+			rect(left, bottom - bar_height(sample.ms[FRAME_GPU]) - 1.0f, bar, 2.0f, glm::vec4(1.0));
+	}
+	rect(x, bottom - bar_height(target_ms), width, 1.0f, glm::vec4(1.0, 0.9, 0.2, 0.9));
+}
+
+void Hud::draw() {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	const FrameStatsSummary stats = frame_stats.summary();
+	const FrameMetricSummary &total = stats.window[FRAME_TOTAL];
+	char buf[256];
+	std::vector<std::string> panel;
+	snprintf(buf, sizeof(buf), "frame p50 %.1f p99 %.1f max %.1f", total.p50, total.p99, total.max);
+	panel.push_back(buf);
+	snprintf(buf, sizeof(buf), "p99 sim %.2f cpu %.2f gpu %.2f", stats.window[FRAME_SIM].p99,
+	         stats.window[FRAME_SUBMIT].p99, stats.window[FRAME_GPU].p99);
+	panel.push_back(buf);
+	panel.insert(panel.end(), lines.begin(), lines.end());
+	snprintf(buf, sizeof(buf), "hud %.3f ms, 1 draw", draw_ms);
+	panel.push_back(buf);
+	lines.clear();
+
+	const float scale = 2.0f, margin = 8.0f, padding = 8.0f;
+	const float line_height = (cell_height + 1) * scale;
+	const float graph_width = 2.0f * HUD_HISTORY, graph_height = 64.0f;
+	size_t longest = 0;
+	for (const std::string &s : panel)
+		longest = std::max(longest, s.size());
+	float width = std::max(graph_width, longest * cell_width * scale) + 2.0f * padding;
+	float height = graph_height + panel.size() * line_height + 3.0f * padding;
+
+	vertices.clear();
+	rect(margin, margin, width, height, glm::vec4(0.1, 0.1, 0.1, 0.6));
+	graph(margin + padding, margin + padding, graph_width, graph_height);
+	float y = margin + 2.0f * padding + graph_height;
+	for (const std::string &s : panel) {
+		text(margin + padding, y, s, glm::vec4(1.0));
+		y += line_height;
+	}
+
+	GLint previous_program, previous_vao, previous_buffer, viewport[4];
+	GLint blend_src_rgb, blend_dst_rgb, blend_src_alpha, blend_dst_alpha;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous_vao);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous_buffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_BLEND_SRC_RGB, &blend_src_rgb);
+	glGetIntegerv(GL_BLEND_DST_RGB, &blend_dst_rgb);
+	glGetIntegerv(GL_BLEND_SRC_ALPHA, &blend_src_alpha);
+	glGetIntegerv(GL_BLEND_DST_ALPHA, &blend_dst_alpha);
+	GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST), blend = glIsEnabled(GL_BLEND);
+
+	glUseProgram(program);
+	glUniform2f(screen_size_location, GLfloat(viewport[2]), GLfloat(viewport[3]));
+	glActiveTexture(GL_TEXTURE0 + HUD_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, font);
+	glActiveTexture(GL_TEXTURE0);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	// orphans last frame's storage, so the upload never waits for the GPU
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STREAM_DRAW);
+	glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()));
+
+	glBindVertexArray(previous_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, previous_buffer);
+	glUseProgram(previous_program);
+	glBlendFuncSeparate(blend_src_rgb, blend_dst_rgb, blend_src_alpha, blend_dst_alpha);
+	if (depth_test)
+		glEnable(GL_DEPTH_TEST);
+	if (!blend)
+		glDisable(GL_BLEND);
+
+	draw_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
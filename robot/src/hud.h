@@ -0,0 +1,72 @@
+// Performance overlay
+//
+// A panel in the top left corner of the window with a graph of the recent frame
+// times, the frame_stats percentiles and whatever lines the demo adds. Glyphs come
+// from a built-in 5x7 font; bars and backgrounds are quads that sample the font's
+// filled cell. Everything queued in a frame goes into one dynamic vertex buffer
+// and is drawn with a single glDrawArrays, so the overlay costs one draw call.
+
+#ifndef HUD_H
+#define HUD_H
+
+#include "common.h"
+#include "frame_stats.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Texture unit the font is bound to while the overlay draws
+const int HUD_TEXTURE_UNIT = 3;
+
+const int HUD_HISTORY = 120;         // frames in the graph
+
+class Hud {
+	struct Vertex {
+		GLfloat x, y;                // window pixels, origin at the top left
+		GLfloat u, v;
+		GLubyte color[4];
+	};
+
+	GLuint program, vao, buffer, font;
+	GLint screen_size_location;
+	std::vector<Vertex> vertices;
+	std::vector<std::string> lines;
+
+	FrameSample history[HUD_HISTORY];
+	int history_next, history_count;
+
+	bool shown;
+	double draw_ms;                  // CPU time of the last draw()
+
+	void quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const glm::vec4 &color);
+	void graph(float x, float y, float width, float height);
+
+public:
+	Hud();
+
+	// Needs the GL context; builds the shader program, font texture and buffers
+	void init();
+
+	void toggle() { shown = !shown; }
+	bool visible() const { return shown; }
+
+	// Called by main.cpp after each frame is recorded
+	void record_frame(const FrameSample &sample);
+
+	// Queues a line of text under the frame statistics; printf formatting
+	void line(const char *format, ...);
+
+	// Rectangle and text in window pixels (scale multiplies the 6x8 pixel cell)
+	void rect(float x, float y, float width, float height, const glm::vec4 &color);
+	void text(float x, float y, const std::string &s, const glm::vec4 &color, float scale = 2.0f);
+
+	// Lays out the panel with the queued lines and draws everything in one call.
+	// Restores the program, vertex array, buffer and blend/depth state it changes.
+	void draw();
+};
+
+extern Hud hud;
+
+#endif // HUD_H
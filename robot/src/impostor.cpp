@@ -0,0 +1,91 @@
+// Impostor atlas for distant characters
+
+#include "impostor.h"
+#include "uniforms.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+const float two_pi = 6.2831853f;
+
+ImpostorAtlas::ImpostorAtlas() : texture(0), framebuffer(0), depth(0), center(0.0f), half_size(1.0f) {
+}
+
+void ImpostorAtlas::bake(const glm::vec3 &c, float h, const std::function<void(float)> &draw) {
+	center = c;
+	half_size = h;
+	int width = IMPOSTOR_PHASES * IMPOSTOR_CELL_SIZE, height = IMPOSTOR_ANGLES * IMPOSTOR_CELL_SIZE;
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	GLint viewport[4];
+	GLfloat clear_color[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+
+	// uncovered texels stay transparent so the billboards can discard them
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	FrameUniforms frame;
+	frame.projection = glm::ortho(-half_size, half_size, -half_size, half_size, 0.1f, 4.0f * half_size);
+	frame.time = glm::vec4(0.0);
+	for (int angle = 0; angle < IMPOSTOR_ANGLES; angle++) {
+		float theta = two_pi * angle / IMPOSTOR_ANGLES;
+		glm::vec3 eye = center + 2.0f * half_size * glm::vec3(std::sin(theta), 0.0f, std::cos(theta));
+		frame.view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+		set_frame_uniforms(frame);
+		for (int phase = 0; phase < IMPOSTOR_PHASES; phase++) {
+			glViewport(phase * IMPOSTOR_CELL_SIZE, angle * IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE);
+			draw(two_pi * phase / IMPOSTOR_PHASES);
+			flush_draws();
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+
+	glActiveTexture(GL_TEXTURE0 + IMPOSTOR_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+int ImpostorAtlas::cell(float cycle, const glm::vec3 &to_camera) const {
+	float turns = cycle / two_pi;
+	int phase = int(std::floor((turns - std::floor(turns)) * IMPOSTOR_PHASES + 0.5f)) % IMPOSTOR_PHASES;
+	float theta = std::atan2(to_camera.x, to_camera.z);
+	int angle = int(std::floor(theta / two_pi * IMPOSTOR_ANGLES + 0.5f));
+	angle = (angle % IMPOSTOR_ANGLES + IMPOSTOR_ANGLES) % IMPOSTOR_ANGLES;
+	return angle * IMPOSTOR_PHASES + phase;
+}
+
+Affine ImpostorAtlas::billboard(const glm::vec3 &position, const glm::vec3 &to_camera) const {
+	glm::vec3 forward = glm::vec3(to_camera.x, 0.0f, to_camera.z);
+	float length = glm::length(forward);
+	forward = length > 0.0f ? forward / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	glm::vec3 up(0.0f, 1.0f, 0.0f);
+	glm::vec3 right = glm::cross(up, forward);
+	float side = 2.0f * half_size;
+	glm::vec3 t = position + center;
+	return Affine(glm::vec4(right.x * side, up.x * side, forward.x, t.x),
+	              glm::vec4(right.y * side, up.y * side, forward.y, t.y),
+	              glm::vec4(right.z * side, up.z * side, forward.z, t.z));
+}
@@ -0,0 +1,58 @@
+// Impostor atlas for distant characters
+//
+// The character is rendered once at start-up into one atlas texture, in a grid of
+// cells: one column per animation phase and one row per view angle around it.
+// A distant instance is then a single billboard facing the camera that samples the
+// cell for its phase and the angle it is seen from (see vshader6.glsl), instead of
+// the ~30 part draws of the full model.
+
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include "common.h"
+#include "affine.h"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+
+// Must match IMPOSTOR_PHASES / IMPOSTOR_ANGLES in vshader6.glsl
+const int IMPOSTOR_PHASES = 16;      // atlas columns, over one 2 pi animation cycle
+const int IMPOSTOR_ANGLES = 8;       // atlas rows, evenly spaced around the y axis
+const int IMPOSTOR_CELL_SIZE = 128;  // pixels
+
+// Texture unit the atlas stays bound to
+const int IMPOSTOR_TEXTURE_UNIT = 1;
+
+// submit_draw() flags of a billboard showing an atlas cell: surface 2 in the low
+// byte, the cell above it (decoded in vshader6.glsl)
+inline int impostor_flags(int cell) {
+	return 2 | (cell << 8);
+}
+
+class ImpostorAtlas {
+	GLuint texture, framebuffer, depth;
+	glm::vec3 center;       // of the character, relative to its placement
+	float half_size;        // half the side of the square each cell covers
+
+public:
+	ImpostorAtlas();
+
+	// Renders draw(cycle) for every phase and angle; draw must queue the character at
+	// the origin with submit_draw(). center and half_size frame it in every cell.
+	// Leaves the default framebuffer bound with the viewport restored; the frame
+	// uniforms must be set again before drawing the scene.
+	void bake(const glm::vec3 &center, float half_size, const std::function<void(float)> &draw);
+
+	// Atlas cell of an instance at animation cycle, seen along to_camera (a direction
+	// in the space of the instance's placement)
+	int cell(float cycle, const glm::vec3 &to_camera) const;
+
+	// Model transform of the square mesh ([-0.5, 0.5]^2 in xy) for an instance placed
+	// at position: upright, turned towards to_camera and sized to the baked cells
+	Affine billboard(const glm::vec3 &position, const glm::vec3 &to_camera) const;
+
+	bool baked() const { return texture != 0; }
+};
+
+#endif // IMPOSTOR_H
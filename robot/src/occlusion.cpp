@@ -0,0 +1,222 @@
+// Software occlusion culling
+
+#include "occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  include <xmmintrin.h>
+#  define OCCLUSION_SSE 1
+#endif
+
+OcclusionBuffer occlusion_buffer;
+
+OcclusionBuffer::OcclusionBuffer(int w, int h) : width(w), height(h), dirty(false) {
+	// an odd texel at the end of a row or column folds into the last texel of the
+	// next level on its own, so every level covers the whole buffer
+	for (int lw = width, lh = height; ; lw = (lw + 1) / 2, lh = (lh + 1) / 2) {
+		levels.push_back(std::vector<float>(size_t(lw) * lh, 1.0f));
+		level_sizes.push_back(glm::ivec2(lw, lh));
+		if (lw == 1 && lh == 1)
+			break;
+	}
+	current = OcclusionStats();
+}
+
+void OcclusionBuffer::begin(const glm::mat4 &vp) {
+	view_projection = vp;
+	std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+	dirty = true;
+	current = OcclusionStats();
+}
+
+//----------------------------------------------------------------------------
+
+// Screen space vertex: pixel coordinates and depth in [0, 1]
+struct ScreenVertex {
+	float x, y, z;
+};
+
+void OcclusionBuffer::rasterize_triangle(const glm::vec4 &ca, const glm::vec4 &cb, const glm::vec4 &cc, float facing) {
+	ScreenVertex v[3];
+	const glm::vec4 *clip[3] = { &ca, &cb, &cc };
+	for (int i = 0; i < 3; i++) {
+		float inv_w = 1.0f / clip[i]->w;
+		v[i].x = (clip[i]->x * inv_w * 0.5f + 0.5f) * width;
+		v[i].y = (clip[i]->y * inv_w * 0.5f + 0.5f) * height;
+		v[i].z = clip[i]->z * inv_w * 0.5f + 0.5f;
+	}
+	float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+	if (area * facing <= 1e-6f)
+		return;              // back facing or degenerate
+	if (area < 0.0f) {
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	int x0 = std::max(0, int(std::floor(std::min(v[0].x, std::min(v[1].x, v[2].x)))));
+	int x1 = std::min(width - 1, int(std::ceil(std::max(v[0].x, std::max(v[1].x, v[2].x)))));
+	int y0 = std::max(0, int(std::floor(std::min(v[0].y, std::min(v[1].y, v[2].y)))));
+	int y1 = std::min(height - 1, int(std::ceil(std::max(v[0].y, std::max(v[1].y, v[2].y)))));
+	if (x0 > x1 || y0 > y1)
+		return;
+	current.triangles++;
+
+	// edge functions E(p) = A * px + B * py + C, positive inside; the edge opposite
+	// vertex i weights its depth
+	float A[3], B[3], C[3];
+	for (int i = 0; i < 3; i++) {
+		const ScreenVertex &a = v[(i + 1) % 3], &b = v[(i + 2) % 3];
+		A[i] = -(b.y - a.y);
+		B[i] = b.x - a.x;
+		C[i] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+	}
+	float inv_area = 1.0f / area;
+	float zA = (A[0] * v[0].z + A[1] * v[1].z + A[2] * v[2].z) * inv_area;
+	float zB = (B[0] * v[0].z + B[1] * v[1].z + B[2] * v[2].z) * inv_area;
+	float zC = (C[0] * v[0].z + C[1] * v[1].z + C[2] * v[2].z) * inv_area;
+
+	x0 &= ~3;
+	float *depth = &levels[0][0];
+	for (int y = y0; y <= y1; y++) {
+		float py = y + 0.5f;
+		float *row = depth + size_t(y) * width;
+#if defined(OCCLUSION_SSE)
+		__m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		__m128 e_step[3], e[3];
+		for (int i = 0; i < 3; i++) {
+			e_step[i] = _mm_set1_ps(4.0f * A[i]);
+			e[i] = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(x0)), lane), _mm_set1_ps(A[i])), _mm_set1_ps(B[i] * py + C[i]));
+		}
+		__m128 z_step = _mm_set1_ps(4.0f * zA);
+		__m128 z = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(x0)), lane), _mm_set1_ps(zA)), _mm_set1_ps(zB * py + zC));
+		__m128 zero = _mm_setzero_ps();
+		for (int x = x0; x <= x1; x += 4) {
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)), _mm_cmpge_ps(e[2], zero));
+			if (_mm_movemask_ps(inside)) {
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+			for (int i = 0; i < 3; i++)
+				e[i] = _mm_add_ps(e[i], e_step[i]);
+			z = _mm_add_ps(z, z_step);
+		}
+#else
+		for (int x = x0; x <= x1; x++) {
+			float px = x + 0.5f;
+			if (A[0] * px + B[0] * py + C[0] >= 0.0f && A[1] * px + B[1] * py + C[1] >= 0.0f && A[2] * px + B[2] * py + C[2] >= 0.0f)
+				row[x] = std::min(row[x], zA * px + zB * py + zC);
+		}
+#endif
+	}
+}
+
+// Clips a polygon against the near plane (z + w >= 0) in place
+static int clip_near(glm::vec4 *poly, int n) {
+	glm::vec4 out[8];
+	int m = 0;
+	for (int i = 0; i < n; i++) {
+		const glm::vec4 &a = poly[i], &b = poly[(i + 1) % n];
+		float da = a.z + a.w, db = b.z + b.w;
+		if (da >= 0.0f)
+			out[m++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f))
+			out[m++] = a + (b - a) * (da / (da - db));
+	}
+	std::copy(out, out + m, poly);
+	return m;
+}
+
+void OcclusionBuffer::add_occluder_box(const Affine &model, const glm::vec3 &lo, const glm::vec3 &hi) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	glm::vec4 corners[8];
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 p((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+		corners[i] = view_projection * glm::vec4(model.transform_point(p), 1.0f);
+	}
+
+	// each face as a quad, counter-clockwise seen from outside; only the front faces
+	// are needed since they cover the back ones. A mirroring model flips the winding.
+	static const int faces[6][4] = {
+		{ 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+	};
+	glm::vec3 x(model.rows[0][0], model.rows[1][0], model.rows[2][0]);
+	glm::vec3 y(model.rows[0][1], model.rows[1][1], model.rows[2][1]);
+	glm::vec3 z(model.rows[0][2], model.rows[1][2], model.rows[2][2]);
+	float facing = glm::dot(glm::cross(x, y), z) < 0.0f ? -1.0f : 1.0f;
+	for (int f = 0; f < 6; f++) {
+		glm::vec4 poly[8];
+		for (int k = 0; k < 4; k++)
+			poly[k] = corners[faces[f][k]];
+		int n = clip_near(poly, 4);
+		for (int k = 1; k + 1 < n; k++)
+			rasterize_triangle(poly[0], poly[k], poly[k + 1], facing);
+	}
+	current.occluders++;
+	dirty = true;
+	current.raster_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void OcclusionBuffer::build_pyramid() {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (size_t k = 1; k < levels.size(); k++) {
+		int lw = level_sizes[k - 1].x, lh = level_sizes[k - 1].y;
+		int nw = level_sizes[k].x, nh = level_sizes[k].y;
+		const float *src = &levels[k - 1][0];
+		float *dst = &levels[k][0];
+		for (int y = 0; y < nh; y++) {
+			const float *r0 = src + size_t(std::min(2 * y, lh - 1)) * lw;
+			const float *r1 = src + size_t(std::min(2 * y + 1, lh - 1)) * lw;
+			for (int x = 0; x < nw; x++) {
+				int xa = std::min(2 * x, lw - 1), xb = std::min(2 * x + 1, lw - 1);
+				dst[size_t(y) * nw + x] = std::max(std::max(r0[xa], r0[xb]), std::max(r1[xa], r1[xb]));
+			}
+		}
+	}
+	dirty = false;
+	current.raster_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//----------------------------------------------------------------------------
+
+bool OcclusionBuffer::test_box(const glm::vec3 &lo, const glm::vec3 &hi) {
+	if (current.occluders == 0)
+		return true;
+	if (dirty)
+		build_pyramid();
+	current.tested++;
+
+	glm::vec3 ndc_min(1e30f), ndc_max(-1e30f);
+	for (int i = 0; i < 8; i++) {
+		glm::vec4 c = view_projection * glm::vec4((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z, 1.0f);
+		if (c.z + c.w < 0.0f)
+			return true;     // reaches in front of the near plane
+		glm::vec3 ndc = glm::vec3(c) / c.w;
+		ndc_min = glm::min(ndc_min, ndc);
+		ndc_max = glm::max(ndc_max, ndc);
+	}
+	if (ndc_max.x < -1.0f || ndc_min.x > 1.0f || ndc_max.y < -1.0f || ndc_min.y > 1.0f)
+		return true;         // off screen; left to frustum culling
+
+	int x0 = std::max(0, int(std::floor((ndc_min.x * 0.5f + 0.5f) * width)));
+	int x1 = std::min(width - 1, int(std::floor((ndc_max.x * 0.5f + 0.5f) * width)));
+	int y0 = std::max(0, int(std::floor((ndc_min.y * 0.5f + 0.5f) * height)));
+	int y1 = std::min(height - 1, int(std::floor((ndc_max.y * 0.5f + 0.5f) * height)));
+	float nearest = ndc_min.z * 0.5f + 0.5f;
+
+	size_t level = 0;
+	while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+	int lw = level_sizes[level].x, lh = level_sizes[level].y;
+	int tx1 = std::min(x1 >> level, lw - 1), ty1 = std::min(y1 >> level, lh - 1);
+	const float *texels = &levels[level][0];
+	for (int y = y0 >> level; y <= ty1; y++)
+		for (int x = x0 >> level; x <= tx1; x++)
+			if (texels[size_t(y) * lw + x] >= nearest)
+				return true;
+	current.occluded++;
+	return false;
+}
@@ -0,0 +1,112 @@
+// Start-up timeline
+
+#include "startup_trace.h"
+#include "common.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct TracePhase {
+	std::string name;
+	int depth;
+	double start_ms, end_ms;
+};
+
+// set during static initialization, just before main()
+static Clock::time_point trace_origin = Clock::now();
+static std::vector<TracePhase> phases;
+static std::vector<size_t> open_phases;
+static bool finished = false;
+
+static double trace_ms() {
+	return std::chrono::duration<double, std::milli>(Clock::now() - trace_origin).count();
+}
+
+void startup_trace_begin(const char *name) {
+	if (finished)
+		return;
+	TracePhase phase;
+	phase.name = name;
+	phase.depth = int(open_phases.size());
+	phase.start_ms = trace_ms();
+	phase.end_ms = phase.start_ms;
+	open_phases.push_back(phases.size());
+	phases.push_back(phase);
+}
+
+void startup_trace_end() {
+	if (finished || open_phases.empty())
+		return;
+	phases[open_phases.back()].end_ms = trace_ms();
+	open_phases.pop_back();
+}
+
+bool startup_trace_active() {
+	return !finished;
+}
+
+static void write_chrome_trace(const char *path) {
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL) {
+		std::cerr << "could not write the start-up trace to " << path << std::endl;
+		return;
+	}
+	fprintf(fp, "{\"traceEvents\": [\n");
+	for (size_t i = 0; i < phases.size(); i++) {
+		std::string name;
+		for (char c : phases[i].name) {
+			if (c == '"' || c == '\\')
+				name += '\\';
+			name += c;
+		}
+		fprintf(fp, "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.1f, \"dur\": %.1f}%s\n",
+		        name.c_str(), phases[i].start_ms * 1000.0, (phases[i].end_ms - phases[i].start_ms) * 1000.0,
+		        i + 1 < phases.size() ? "," : "");
+	}
+	fprintf(fp, "], \"displayTimeUnit\": \"ms\"}\n");
+	fclose(fp);
+}
+
+void startup_trace_first_frame() {
+	if (finished)
+		return;
+
+	// the swap only queued the frame; wait until the GPU has finished it
+	startup_trace_begin("first frame on the GPU");
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	GLenum status;
+	do
+		status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);   // ns
+	while (status == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(fence);
+	startup_trace_end();
+
+	while (!open_phases.empty())
+		startup_trace_end();
+	double total_ms = trace_ms();
+	finished = true;
+
+#ifdef DEBUG
+	std::cout << "start-up: " << total_ms << " ms to the first frame on screen" << std::endl;
+	for (const TracePhase &phase : phases) {
+		char line[160];
+		snprintf(line, sizeof(line), "  %8.1f %8.1f ms  %*s%s", phase.start_ms, phase.end_ms - phase.start_ms,
+		         2 * phase.depth, "", phase.name.c_str());
+		std::cout << line << std::endl;
+	}
+#endif
+
+	const char *path = getenv("STARTUP_TRACE");
+	if (path != NULL && *path != '\0')
+		write_chrome_trace(path);
+
+	const char *budget = getenv("STARTUP_BUDGET_MS");
+	if (budget != NULL && total_ms > atof(budget))
+		std::cerr << "start-up took " << total_ms << " ms, over the " << budget << " ms budget" << std::endl;
+}
@@ -0,0 +1,33 @@
+// Start-up timeline
+//
+// Named, nestable phases from main() to the first frame on screen, timed with the
+// high resolution clock. The trace ends once a fence placed after the first swap
+// has signalled, so it includes the GPU work of the first frame. A summary is
+// printed in debug builds; when the STARTUP_TRACE environment variable names a file
+// the phases are also written there as a Chrome trace (chrome://tracing, Perfetto),
+// and when STARTUP_BUDGET_MS is set a slower start-up is reported on stderr.
+
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+// Phases must be ended in the reverse order they were begun. After the trace has
+// finished both calls do nothing.
+extern void startup_trace_begin(const char *name);
+extern void startup_trace_end();
+
+// Begins a phase for the lifetime of a scope
+struct StartupPhase {
+	explicit StartupPhase(const char *name) { startup_trace_begin(name); }
+	~StartupPhase() { startup_trace_end(); }
+
+private:
+	StartupPhase(const StartupPhase &);
+	StartupPhase &operator=(const StartupPhase &);
+};
+
+// Call after the first frame has been swapped: waits for the GPU and ends the trace
+extern void startup_trace_first_frame();
+
+extern bool startup_trace_active();
+
+#endif // STARTUP_TRACE_H
@@ -0,0 +1,137 @@
+// Live telemetry in shared memory
+
+#include "telemetry.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+Telemetry telemetry;
+
+static const char telemetry_magic[8] = "BATELEM";
+
+static double now_seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Telemetry::Telemetry() : block(NULL), open_time(0.0) {
+	shm_name[0] = '\0';
+	memset(&staging, 0, sizeof(staging));
+	memset(keys, 0, sizeof(keys));
+}
+
+Telemetry::~Telemetry() {
+	close();
+}
+
+bool Telemetry::open() {
+#ifdef _WIN32
+	return false;
+#else
+	if (block != NULL)
+		return true;
+	snprintf(shm_name, sizeof(shm_name), "/block-anim-%d", int(getpid()));
+	int fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	void *memory = MAP_FAILED;
+	if (ftruncate(fd, sizeof(TelemetryBlock)) == 0)
+		memory = mmap(NULL, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		shm_unlink(shm_name);
+		return false;
+	}
+
+	// the zero-filled block is valid; the magic goes in last so a reader never sees a
+	// half-initialized header
+	block = (TelemetryBlock *)memory;
+	block->version = TELEMETRY_VERSION;
+	block->pid = uint32_t(getpid());
+	block->sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(block->magic, telemetry_magic, sizeof(block->magic));
+	open_time = now_seconds();
+	return true;
+#endif
+}
+
+void Telemetry::close() {
+#ifndef _WIN32
+	if (block == NULL)
+		return;
+	munmap(block, sizeof(TelemetryBlock));
+	shm_unlink(shm_name);
+	block = NULL;
+#endif
+}
+
+void Telemetry::set(const char *name, double value) {
+	// callers pass string literals, so the pointer usually matches
+	for (uint32_t i = 0; i < staging.counters; i++) {
+		if (keys[i] == name) {
+			staging.values[i] = value;
+			return;
+		}
+	}
+	for (uint32_t i = 0; i < staging.counters; i++) {
+		if (strcmp(staging.names[i], name) == 0) {
+			keys[i] = name;
+			staging.values[i] = value;
+			return;
+		}
+	}
+	if (staging.counters == TELEMETRY_COUNTERS)
+		return;
+	uint32_t i = staging.counters++;
+	keys[i] = name;
+	strncpy(staging.names[i], name, TELEMETRY_NAME_LENGTH - 1);
+	staging.names[i][TELEMETRY_NAME_LENGTH - 1] = '\0';
+	staging.values[i] = value;
+}
+
+void Telemetry::publish() {
+	staging.frame++;
+	if (block == NULL)
+		return;
+
+	uint64_t sequence = block->sequence.load(std::memory_order_relaxed);
+	block->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	uint32_t n = staging.counters;
+	block->frame = staging.frame;
+	block->seconds = now_seconds() - open_time;
+	block->counters = n;
+	memcpy(block->names, staging.names, n * sizeof(staging.names[0]));
+	memcpy(block->values, staging.values, n * sizeof(staging.values[0]));
+
+	block->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool telemetry_read(const TelemetryBlock *block, TelemetrySnapshot &snapshot) {
+	if (memcmp(block->magic, telemetry_magic, sizeof(block->magic)) != 0 || block->version != TELEMETRY_VERSION)
+		return false;
+	for (int attempt = 0; attempt < 4096; attempt++) {
+		uint64_t before = block->sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+		snapshot.frame = block->frame;
+		snapshot.seconds = block->seconds;
+		snapshot.counters = block->counters;
+		if (snapshot.counters > uint32_t(TELEMETRY_COUNTERS))
+			continue;
+		memcpy(snapshot.names, block->names, snapshot.counters * sizeof(snapshot.names[0]));
+		memcpy(snapshot.values, block->values, snapshot.counters * sizeof(snapshot.values[0]));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (block->sequence.load(std::memory_order_relaxed) == before)
+			return true;
+	}
+	return false;
+}
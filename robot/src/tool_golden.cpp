@@ -0,0 +1,168 @@
+// Compares the frames of an offline run with stored reference frames
+//
+//  make golden                      # render, then compare with golden/reference
+//  make golden-baseline             # compare with the unoptimized (--baseline) frames
+//  ../build/tool_golden [--tolerance T] [--max-fraction F] reference_dir frames_dir
+//
+// Every frame_*.ppm in reference_dir must have a counterpart in frames_dir. Pixels
+// are compared with the "redmean" weighted RGB distance, a cheap approximation of
+// perceived colour difference scaled to 0..255; a pixel differs when its distance
+// is over the tolerance (default 8), and a frame fails when more than max-fraction
+// of its pixels differ (default 0.001), so rasterization noise along edges passes
+// but a moved or missing object does not. For each failing frame a diff image is
+// written next to it: the reference in grey with the differing pixels in red.
+// Exits with 0 only when every frame passes.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+struct Image {
+	int width, height;
+	std::vector<unsigned char> rgb;
+};
+
+// Binary PPM as written by frame_capture (no comments in the header)
+static bool read_ppm(const std::string &path, Image &image) {
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+	int max_value = 0;
+	bool ok = fscanf(fp, "P6 %d %d %d", &image.width, &image.height, &max_value) == 3 && max_value == 255 &&
+	          image.width > 0 && image.height > 0 && fgetc(fp) != EOF;
+	if (ok) {
+		image.rgb.resize(size_t(image.width) * image.height * 3);
+		ok = fread(&image.rgb[0], 1, image.rgb.size(), fp) == image.rgb.size();
+	}
+	fclose(fp);
+	return ok;
+}
+
+static bool write_ppm(const std::string &path, const Image &image) {
+	FILE *fp = fopen(path.c_str(), "wb");
+	if (fp == NULL)
+		return false;
+	fprintf(fp, "P6\n%d %d\n255\n", image.width, image.height);
+	bool ok = fwrite(&image.rgb[0], 1, image.rgb.size(), fp) == image.rgb.size();
+	return fclose(fp) == 0 && ok;
+}
+
+static float pixel_distance(const unsigned char *a, const unsigned char *b) {
+	float r_mean = 0.5f * (a[0] + b[0]);
+	float dr = float(a[0]) - b[0], dg = float(a[1]) - b[1], db = float(a[2]) - b[2];
+	float d2 = (2.0f + r_mean / 256.0f) * dr * dr + 4.0f * dg * dg + (2.0f + (255.0f - r_mean) / 256.0f) * db * db;
+	return sqrtf(d2) / 3.0f;
+}
+
+struct FrameDiff {
+	long differing;        // pixels over the tolerance
+	float max_distance;
+	double psnr;           // dB over all channels; infinite when identical
+};
+
+static FrameDiff compare(const Image &reference, const Image &frame, float tolerance, Image &diff) {
+	FrameDiff result = { 0, 0.0f, 0.0 };
+	diff = reference;
+	double squared = 0.0;
+	size_t pixels = size_t(reference.width) * reference.height;
+	for (size_t i = 0; i < pixels; i++) {
+		const unsigned char *a = &reference.rgb[i * 3], *b = &frame.rgb[i * 3];
+		for (int c = 0; c < 3; c++)
+			squared += double(int(a[c]) - b[c]) * (int(a[c]) - b[c]);
+		float distance = pixel_distance(a, b);
+		result.max_distance = std::max(result.max_distance, distance);
+		unsigned char *d = &diff.rgb[i * 3];
+		if (distance > tolerance) {
+			result.differing++;
+			d[0] = 255;
+			d[1] = d[2] = 0;
+		} else {
+			d[0] = d[1] = d[2] = (unsigned char)((77 * a[0] + 150 * a[1] + 29 * a[2]) >> 9) + 64;
+		}
+	}
+	double mse = squared / (pixels * 3.0);
+	result.psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+	return result;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: tool_golden [--tolerance T] [--max-fraction F] reference_dir frames_dir\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	float tolerance = 8.0f;
+	double max_fraction = 0.001;
+	std::vector<std::string> dirs;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			tolerance = float(atof(argv[++i]));
+		else if (strcmp(argv[i], "--max-fraction") == 0 && i + 1 < argc)
+			max_fraction = atof(argv[++i]);
+		else if (argv[i][0] == '-')
+			usage();
+		else
+			dirs.push_back(argv[i]);
+	}
+	if (dirs.size() != 2)
+		usage();
+
+	std::vector<std::string> names;
+	DIR *dir = opendir(dirs[0].c_str());
+	if (dir == NULL) {
+		fprintf(stderr, "no references in %s; record them with make golden-update\n", dirs[0].c_str());
+		return 1;
+	}
+	for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.compare(0, 6, "frame_") == 0 && name.size() > 4 && name.compare(name.size() - 4, 4, ".ppm") == 0)
+			names.push_back(name);
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+	if (names.empty()) {
+		fprintf(stderr, "no frame_*.ppm in %s\n", dirs[0].c_str());
+		return 1;
+	}
+
+	int failed = 0;
+	printf("%-20s %10s %8s %9s\n", "frame", "differing", "max", "psnr");
+	for (const std::string &name : names) {
+		Image reference, frame, diff;
+		if (!read_ppm(dirs[0] + "/" + name, reference)) {
+			printf("%-20s unreadable reference\n", name.c_str());
+			failed++;
+			continue;
+		}
+		if (!read_ppm(dirs[1] + "/" + name, frame)) {
+			printf("%-20s missing\n", name.c_str());
+			failed++;
+			continue;
+		}
+		if (frame.width != reference.width || frame.height != reference.height) {
+			printf("%-20s %dx%d, reference is %dx%d\n", name.c_str(), frame.width, frame.height, reference.width,
+			       reference.height);
+			failed++;
+			continue;
+		}
+
+		FrameDiff result = compare(reference, frame, tolerance, diff);
+		double fraction = double(result.differing) / (double(reference.width) * reference.height);
+		bool pass = fraction <= max_fraction;
+		printf("%-20s %9.3f%% %8.1f %6.1f dB%s\n", name.c_str(), 100.0 * fraction, result.max_distance, result.psnr,
+		       pass ? "" : "  FAIL");
+		if (!pass) {
+			failed++;
+			write_ppm(dirs[1] + "/diff_" + name, diff);
+		}
+	}
+	printf("%d of %d frames %s\n", failed > 0 ? failed : int(names.size()), int(names.size()),
+	       failed > 0 ? "differ from the reference" : "match the reference");
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+// Watches the live telemetry of a running demo
+//
+//  make tools && ../build/tool_telemetry [pid]
+//
+// Without a pid it picks the newest /block-anim-* block in /dev/shm (Linux); on OS X,
+// where shared memory cannot be listed, pass the pid of the demo. Redraws the
+// counters four times a second until the demo exits.
+
+#include "telemetry.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+
+int main() {
+	fprintf(stderr, "tool_telemetry needs POSIX shared memory\n");
+	return 1;
+}
+
+#else
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Name of the newest block whose writer is still alive, or "" when there is none
+static std::string find_block() {
+	std::string best;
+	time_t best_time = 0;
+	DIR *dir = opendir("/dev/shm");
+	if (dir == NULL)
+		return best;
+	while (dirent *entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.compare(0, 11, "block-anim-") != 0)
+			continue;
+		struct stat info;
+		int pid = atoi(name.c_str() + 11);
+		if (pid <= 0 || kill(pid, 0) != 0 || stat(("/dev/shm/" + name).c_str(), &info) != 0)
+			continue;
+		if (best.empty() || info.st_mtime > best_time) {
+			best = "/" + name;
+			best_time = info.st_mtime;
+		}
+	}
+	closedir(dir);
+	return best;
+}
+
+int main(int argc, char **argv) {
+	std::string name = argc > 1 ? "/block-anim-" + std::string(argv[1]) : find_block();
+	if (name.empty()) {
+		fprintf(stderr, "no running demo found; pass its pid\n");
+		return 1;
+	}
+
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		fprintf(stderr, "cannot open %s\n", name.c_str());
+		return 1;
+	}
+	void *memory = mmap(NULL, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s\n", name.c_str());
+		return 1;
+	}
+	const TelemetryBlock *block = (const TelemetryBlock *)memory;
+
+	TelemetrySnapshot snapshot, previous;
+	bool have_previous = false;
+	for (;;) {
+		if (block->pid != 0 && kill(pid_t(block->pid), 0) != 0) {
+			printf("demo exited\n");
+			break;
+		}
+		if (telemetry_read(block, snapshot)) {
+			double fps = 0.0;
+			if (have_previous && snapshot.seconds > previous.seconds)
+				fps = (snapshot.frame - previous.frame) / (snapshot.seconds - previous.seconds);
+			// clear the terminal and redraw from the top
+			printf("\033[H\033[2J%s  frame %llu  %.1f s  %.1f fps\n\n", name.c_str(),
+			       (unsigned long long)snapshot.frame, snapshot.seconds, fps);
+			for (uint32_t i = 0; i < snapshot.counters; i++)
+				printf("  %-*s %14.3f\n", TELEMETRY_NAME_LENGTH, snapshot.names[i], snapshot.values[i]);
+			fflush(stdout);
+			previous = snapshot;
+			have_previous = true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	}
+	munmap(memory, sizeof(TelemetryBlock));
+	return 0;
+}
+
+#endif
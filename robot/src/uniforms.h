@@ -0,0 +1,73 @@
+// std140 uniform blocks shared with vshader6.glsl / fshader5.glsl
+//
+// FrameBlock holds the constants that change once per frame (projection, view, time)
+// and DrawBlock holds an array of per-draw constants indexed by gl_InstanceID.
+// Draws are queued with submit_draw() and flushed as one instanced draw call per
+// run of the same mesh, so no glUniform* calls are made per draw. Draws whose
+// bounding sphere is outside the view frustum, or hidden behind the occluders given
+// to occlusion_buffer this frame, are dropped at flush time.
+
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include "common.h"
+#include "affine.h"
+
+#include <glm/glm.hpp>
+
+// Uniform buffer binding points
+enum { FrameBlockBinding = 0, DrawBlockBinding = 1 };
+
+// Must match MAX_DRAWS in vshader6.glsl
+const int MAX_DRAWS = 128;
+
+// layout(std140) uniform FrameBlock
+struct FrameUniforms {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 time;        // x = seconds
+};
+
+// One element of layout(std140) uniform DrawBlock { DrawData draws[MAX_DRAWS]; }
+struct DrawUniforms {
+	Affine model;          // mat3x4 in GLSL
+	glm::vec4 color;
+	glm::vec4 spin;        // xyz = unit axis, w = angle in radians, applied before model
+	glm::ivec4 flags;      // x = patterned surface (textured block / animated floor)
+};
+
+// An indexed mesh living in its own vertex array object
+struct Mesh {
+	GLuint vao;
+	GLsizei first;         // first index
+	GLsizei count;         // number of indices
+	glm::vec4 bounds;      // bounding sphere in mesh space: xyz = centre, w = radius
+};
+
+// Culling counts of the last flush_draws()
+struct CullStats {
+	int tested;
+	int culled;            // outside the frustum
+	int occluded;          // inside the frustum but hidden
+	int drawn;
+	int batches;           // instanced draw calls they were batched into
+};
+
+extern CullStats cull_stats;
+
+extern void init_uniform_blocks(GLuint program);
+extern void set_frame_uniforms(const FrameUniforms &frame);
+
+// Queue a draw; outline draws are rendered as wireframe triangles
+extern void submit_draw(const Mesh &mesh, const Affine &model, const glm::vec4 &color, int flags = 0, bool outline = false, const glm::vec4 &spin = glm::vec4(0.0));
+// Queue a draw the caller has already tested against occlusion_buffer; it is still
+// frustum culled but not occlusion tested again at flush time
+extern void submit_tested_draw(const Mesh &mesh, const Affine &model, const glm::vec4 &color, int flags = 0);
+
+// Upload every queued draw in one buffer update and issue the instanced draw calls.
+// Draws of the same mesh are grouped at the position of that mesh's first draw;
+// submission order is preserved within a mesh and between the groups. Without cull
+// every queued draw is drawn (the baseline path, see BaselineRendering()).
+extern void flush_draws(bool cull = true);
+
+#endif // UNIFORMS_H
@@ -1,22 +1,48 @@
 #version 150
 
+#define MAX_DRAWS 128
+
+// Must match impostor.h
+#define IMPOSTOR_PHASES 16
+#define IMPOSTOR_ANGLES 8
+
+struct DrawData {
+    mat3x4 model;          // rows of an affine transform
+    vec4 color;
+    vec4 spin;             // axis, angle
+    ivec4 flags;
+};
+
+layout(std140) uniform FrameBlock {
+    mat4 Projection;
+    mat4 View;
+    vec4 Time;
+};
+
+layout(std140) uniform DrawBlock {
+    DrawData draws[MAX_DRAWS];
+};
+
 in vec4 vPosition;
-uniform mat4 ModelView, Projection;
-uniform vec4 SetColor;
-uniform int IsFloorInput;
-uniform float SetTime;
 
 out vec4 color;
 out vec2 uv;
-flat out float time;
-flat out int is_floor;
+flat out int surface;
+
 
 void main()
 {
-    gl_Position = Projection * ModelView * vPosition;
-    color = SetColor;
-    is_floor = IsFloorInput;
-    uv = normalize(vPosition.xy);
-    time = SetTime;
+    DrawData draw = draws[gl_InstanceID];
+    gl_Position = Projection * View * vec4(vPosition * draw.model, 1.0);
+    color = draw.color;
+    surface = draw.flags.x & 255;
+    if (surface == 2) {
+        // impostor billboard: the atlas cell is packed above the surface kind, with
+        // phases across and angles up
+        int index = draw.flags.x >> 8;
+        vec2 cell = vec2(index % IMPOSTOR_PHASES, index / IMPOSTOR_PHASES);
+        uv = (cell + vPosition.xy + 0.5) / vec2(IMPOSTOR_PHASES, IMPOSTOR_ANGLES);
+    }
+    else
+        uv = normalize(vPosition.xy);
 }
-
@@ -0,0 +1,20 @@
+#version 150
+
+// Overlay quads in window pixels, origin at the top left
+
+uniform vec2 screen_size;
+
+in vec2 position;
+in vec2 glyph_uv;
+in vec4 quad_color;
+
+out vec2 uv_pos;
+out vec4 draw_color;
+
+void main()
+{
+    vec2 ndc = position / screen_size * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    uv_pos = glyph_uv;
+    draw_color = quad_color;
+}